@@ -0,0 +1,716 @@
+// AC indoor unit emulator for testing controllers on Linux. Exposes a pseudo-terminal that a
+// controller (for example the ESPHome controller built for the host platform, or a USB serial
+// adapter bridged with socat) can connect to.
+//
+// Unlike ac-emulator.py this implements most of the message types from protocol.md: status (C8),
+// capabilities (C9), settings (CA/CB), more status (CC), CE 80 and power (CF). It also sends the
+// initialization dump when the controller sets bit 0x40 of byte 8 and echoes all bytes written
+// by the controller, just like the real single-wire bus.
+//
+// Build:
+//
+//    $ g++ -std=c++17 -O2 -Wall -o ac-emulator ac-emulator.cpp
+//
+// Typical usage:
+//
+//    $ ./ac-emulator --link /tmp/lg-ac --speed 60 --scenario defrost.txt
+//
+// Options:
+//    --link PATH        Create a symlink to the pty slave device.
+//    --speed N          Time acceleration factor for the unit's timers, the room temperature
+//                       model and scenarios. Default 1.
+//    --no-wire-delay    Don't emulate the 104 bps transmission time of outgoing bytes.
+//    --scenario FILE    Run commands from FILE at the given (virtual) times.
+//    --duration SECS    Exit after this many virtual seconds.
+//    --quiet            Only print unexpected messages and scenario commands.
+//
+// Scenario files have one command per line. Empty lines and lines starting with # are ignored.
+//
+//    at SECS COMMAND...              Run COMMAND once, SECS virtual seconds after start.
+//    every PERIOD OFFSET COMMAND...  Run COMMAND every PERIOD seconds, starting at OFFSET.
+//
+// Commands:
+//    room_temp C            Room temperature measured by the unit's thermistor.
+//    outdoor on|off         Outdoor unit state (disables the automatic thermostat model).
+//    auto                   Re-enable the automatic thermostat model.
+//    defrost on|off
+//    preheat on|off
+//    error CODE             Error code in byte 11 (0 clears it).
+//    pipe in|mid|out C      Pipe temperature.
+//    power W                Power usage for CF messages.
+//    humidity PCT           Humidity for CE 80 messages.
+//    status                 Send a status message now.
+//    quit
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t MsgLen = 13;
+using Message = std::vector<uint8_t>;
+
+// Time for one byte at 104 bps with 8N1 framing.
+constexpr double ByteMillis = 10 * 1000.0 / 104;
+
+uint8_t calc_checksum(const uint8_t* buffer) {
+    size_t result = 0;
+    for (size_t i = 0; i < 12; i++) {
+        result += buffer[i];
+    }
+    return (result & 0xff) ^ 0x55;
+}
+
+double real_millis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+std::string hex(const uint8_t* buf, size_t len) {
+    std::string s;
+    char tmp[4];
+    for (size_t i = 0; i < len; i++) {
+        snprintf(tmp, sizeof(tmp), i == 0 ? "%02x" : ".%02x", buf[i]);
+        s += tmp;
+    }
+    return s;
+}
+
+// Byte value for a pipe temperature in degrees C, based on the table in protocol.md. Returns the
+// first (highest) byte value with a temperature less than or equal to the requested one.
+uint8_t pipe_temp_to_byte(int temp) {
+    static constexpr int8_t PipeTempTable[] = {
+        /* 0x00 */ 127, 127, 127, 127, 127, 127, 127, 127, 127, 127, 108, 104, 101, 100, 98, 95,
+        /* 0x10 */ 93, 91, 89, 87, 85, 84, 82, 81, 79, 78, 76, 75, 74, 73, 72, 71,
+        /* 0x20 */ 70, 68, 68, 67, 66, 65, 64, 63, 62, 61, 60, 60, 59, 58, 57, 57,
+        /* 0x30 */ 56, 55, 55, 54, 53, 53, 52, 52, 51, 50, 50, 49, 49, 48, 47, 47,
+        /* 0x40 */ 46, 46, 45, 45, 44, 44, 43, 43, 42, 42, 41, 41, 40, 40, 39, 39,
+        /* 0x50 */ 39, 38, 38, 37, 37, 36, 36, 36, 35, 35, 34, 34, 33, 33, 33, 32,
+        /* 0x60 */ 32, 31, 31, 31, 30, 30, 30, 29, 29, 29, 28, 28, 27, 27, 27, 26,
+        /* 0x70 */ 26, 26, 25, 25, 24, 24, 24, 23, 23, 23, 22, 22, 22, 21, 21, 21,
+        /* 0x80 */ 20, 20, 20, 19, 19, 19, 18, 18, 18, 17, 17, 17, 16, 16, 16, 15,
+        /* 0x90 */ 15, 15, 14, 14, 14, 13, 13, 13, 12, 12, 12, 11, 11, 11, 10, 10,
+        /* 0xa0 */ 10, 9, 9, 9, 8, 8, 8, 7, 7, 6, 6, 6, 5, 5, 5, 4,
+        /* 0xb0 */ 4, 4, 3, 3, 3, 2, 2, 2, 1, 1, 0, 0, 0, 0, 0, -1,
+        /* 0xc0 */ -1, -2, -2, -2, -3, -3, -4, -4, -5, -5, -5, -6, -6, -7, -7, -8,
+        /* 0xd0 */ -8, -9, -9, -9, -10, -10, -11, -11, -12, -12, -13, -14, -14, -15, -15, -16,
+        /* 0xe0 */ -16, -17, -18, -18, -19, -20, -20, -21, -22, -22, -23, -24, -25, -26, -27, -28,
+        /* 0xf0 */ -29,
+    };
+    for (size_t i = 0x0a; i < sizeof(PipeTempTable); i++) {
+        if (PipeTempTable[i] <= temp) {
+            return uint8_t(i);
+        }
+    }
+    return 0xf0;
+}
+
+struct UnitState {
+    // Status (C8).
+    bool power = false;
+    uint8_t mode = 0;      // 0: cool, 1: dehumidify, 2: fan, 3: auto, 4: heat
+    uint8_t fan = 1;       // 0: low, 1: medium, 2: high, 3: auto, 4: slow
+    uint8_t byte2 = 0;     // Swing, purifier etc. Stored as received.
+    bool reservation = false;
+    uint8_t setpoint_x2 = 44; // 22C
+    uint8_t thermistor = 0;
+    double controller_temp = 22;
+    double unit_temp = 24;
+    bool outdoor = false;
+    bool outdoor_auto = true;
+    bool defrost = false;
+    bool preheat = false;
+    uint8_t error = 0;
+    uint8_t timer_byte8 = 0;
+    uint8_t timer_byte9 = 0;
+
+    // Settings (CA/CB).
+    uint8_t address = 0;
+    uint8_t fan_speeds[5] = {};
+    uint8_t vanes[2] = {};
+    uint8_t ca_byte11 = 0;
+    uint8_t cb_byte1 = 0;  // DRED
+    uint8_t cb_byte2 = 0;  // Over heating/cooling
+    int pipe_in = 22;
+    int pipe_mid = 22;
+    int pipe_out = 22;
+
+    // Other status.
+    uint8_t humidity = 50;
+    uint32_t power_watts = 0;
+    double energy_kwh = 0;
+
+    // Installer settings received through AD and AE 10 messages.
+    uint8_t ad_settings[MsgLen] = {};
+    uint8_t ae_settings[MsgLen] = {};
+};
+
+class Emulator {
+    int fd_;
+    double speed_;
+    bool wire_delay_;
+    bool quiet_;
+
+    double start_real_ = real_millis();
+
+    UnitState state_;
+    // C9 capabilities, same as ac-emulator.py but with DRED support (byte 10).
+    uint8_t capabilities_[MsgLen] = {0xC9, 0xC4, 0xEA, 0x1F, 0x81, 0x71, 0x00, 0x80, 0x02, 0x40, 0x05, 0x81};
+
+    // Received bytes.
+    uint8_t recv_buf_[MsgLen] = {};
+    size_t recv_len_ = 0;
+    double last_recv_real_ = 0;
+
+    // Queue of outgoing messages and the message currently being transmitted.
+    std::deque<Message> send_queue_;
+    Message sending_;
+    size_t sending_pos_ = 0;
+    double next_byte_real_ = 0;
+    bool collision_ = false;
+
+    double last_status_virtual_ = 0;
+    double last_model_virtual_ = 0;
+
+    struct ScenarioEntry {
+        double time;
+        double period; // 0: run once
+        std::string command;
+    };
+    std::vector<ScenarioEntry> scenario_;
+
+public:
+    Emulator(int fd, double speed, bool wire_delay, bool quiet)
+      : fd_(fd), speed_(speed), wire_delay_(wire_delay), quiet_(quiet) {}
+
+    // Virtual time in milliseconds since start.
+    double now() const {
+        return (real_millis() - start_real_) * speed_;
+    }
+
+    bool load_scenario(const char* path) {
+        std::ifstream file(path);
+        if (!file) {
+            fprintf(stderr, "Failed to open scenario %s\n", path);
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream ss(line);
+            std::string kind;
+            if (!(ss >> kind) || kind[0] == '#') {
+                continue;
+            }
+            ScenarioEntry entry{0, 0, {}};
+            if (kind == "at") {
+                ss >> entry.time;
+            } else if (kind == "every") {
+                ss >> entry.period >> entry.time;
+            } else {
+                fprintf(stderr, "Invalid scenario line: %s\n", line.c_str());
+                return false;
+            }
+            std::getline(ss >> std::ws, entry.command);
+            entry.time *= 1000;
+            entry.period *= 1000;
+            scenario_.push_back(entry);
+        }
+        return true;
+    }
+
+    // Returns false when the emulator should exit.
+    bool run(double duration_ms) {
+        while (duration_ms <= 0 || now() < duration_ms) {
+            pollfd pfd{fd_, POLLIN, 0};
+            int ret = poll(&pfd, 1, 2);
+            if (ret < 0 && errno != EINTR) {
+                perror("poll");
+                return false;
+            }
+            if (ret > 0 && (pfd.revents & POLLIN)) {
+                uint8_t buf[64];
+                ssize_t n = read(fd_, buf, sizeof(buf));
+                for (ssize_t i = 0; i < n; i++) {
+                    receive_byte(buf[i]);
+                }
+            }
+            if (recv_len_ > 0 && real_millis() - last_recv_real_ > 5 * ByteMillis) {
+                fprintf(stderr, "%s discarding incomplete data %s\n", timestamp().c_str(),
+                        hex(recv_buf_, recv_len_).c_str());
+                recv_len_ = 0;
+            }
+            if (!run_scenario()) {
+                return false;
+            }
+            run_model();
+            run_timers();
+            transmit();
+        }
+        return true;
+    }
+
+private:
+    std::string timestamp() const {
+        char buf[32];
+        double secs = now() / 1000;
+        snprintf(buf, sizeof(buf), "[%02d:%02d:%06.3f]", int(secs / 3600), int(secs / 60) % 60,
+                 fmod(secs, 60));
+        return buf;
+    }
+
+    void write_byte(uint8_t b) {
+        while (write(fd_, &b, 1) < 0 && errno == EAGAIN) {
+            usleep(100);
+        }
+    }
+
+    // Controller bytes are echoed immediately. If we're transmitting at the same time, both
+    // sides see the bitwise AND of the two bytes (low is dominant on the bus).
+    void receive_byte(uint8_t b) {
+        if (!sending_.empty() && sending_pos_ > 0) {
+            uint8_t ours = sending_[sending_pos_ - 1];
+            if ((b & ours) != ours) {
+                collision_ = true;
+            }
+            b &= ours;
+        }
+        write_byte(b);
+        recv_buf_[recv_len_++] = b;
+        last_recv_real_ = real_millis();
+        if (recv_len_ == MsgLen) {
+            recv_len_ = 0;
+            process_message(recv_buf_);
+        }
+    }
+
+    void queue(Message msg) {
+        msg.resize(MsgLen);
+        msg[12] = calc_checksum(msg.data());
+        send_queue_.push_back(std::move(msg));
+    }
+
+    // Sends the next byte of the current message when the bus allows it. New messages are only
+    // started if the controller isn't transmitting.
+    void transmit() {
+        double t = real_millis();
+        if (sending_.empty()) {
+            if (send_queue_.empty() || recv_len_ > 0 || t - last_recv_real_ < 4 * ByteMillis) {
+                return;
+            }
+            sending_ = std::move(send_queue_.front());
+            send_queue_.pop_front();
+            sending_pos_ = 0;
+            collision_ = false;
+            next_byte_real_ = t;
+        }
+        if (wire_delay_ && t < next_byte_real_) {
+            return;
+        }
+        if (sending_pos_ == sending_.size()) {
+            if (!quiet_ || collision_) {
+                printf("%s write %s%s\n", timestamp().c_str(), hex(sending_.data(), MsgLen).c_str(),
+                       collision_ ? " (collision, retrying)" : "");
+            }
+            if (collision_) {
+                send_queue_.push_front(sending_);
+            }
+            sending_.clear();
+            return;
+        }
+        write_byte(sending_[sending_pos_++]);
+        next_byte_real_ += ByteMillis;
+    }
+
+    void process_message(const uint8_t* buf) {
+        if (calc_checksum(buf) != buf[12]) {
+            printf("%s read  %s (invalid checksum)\n", timestamp().c_str(), hex(buf, MsgLen).c_str());
+            return;
+        }
+        if (!quiet_) {
+            printf("%s read  %s\n", timestamp().c_str(), hex(buf, MsgLen).c_str());
+        }
+        uint8_t source = buf[0] & 0xf8;
+        if (source != 0xA8 && source != 0x28) {
+            return;
+        }
+        switch (buf[0] & 0x7) {
+            case 0:
+                process_status(buf);
+                break;
+            case 2:
+                process_type_a(buf);
+                break;
+            case 3:
+                process_type_b(buf);
+                break;
+            case 5:
+                memcpy(state_.ad_settings, buf, MsgLen);
+                break;
+            case 6:
+                if (buf[1] == 0x10) {
+                    memcpy(state_.ae_settings, buf, MsgLen);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void process_status(const uint8_t* buf) {
+        bool changed = buf[1] & 0x1;
+        if (changed) {
+            state_.power = buf[1] & 0x2;
+            state_.mode = (buf[1] >> 2) & 0x7;
+            state_.fan = buf[1] >> 5;
+            state_.byte2 = buf[2];
+            state_.reservation = buf[3] & 0x10;
+            state_.setpoint_x2 = ((buf[6] & 0xf) + 15) * 2 + (buf[5] & 0x1);
+            if (((buf[8] >> 3) & 0x7) != 0) {
+                state_.timer_byte8 = buf[8] & 0x3f;
+                state_.timer_byte9 = buf[9];
+            }
+        }
+        state_.thermistor = (buf[6] >> 4) & 0x3;
+        if (state_.thermistor == 1) {
+            state_.controller_temp = double(buf[7] & 0x3f) / 2 + 10;
+        }
+        if (buf[8] & 0x40) {
+            send_init_dump();
+        } else if (changed) {
+            // Confirm the change, twice like the real unit.
+            queue_status(true);
+            queue_status(true);
+        }
+    }
+
+    void process_type_a(const uint8_t* buf) {
+        state_.address = buf[1];
+        memcpy(state_.fan_speeds, buf + 2, 5);
+        state_.vanes[0] = buf[7];
+        state_.vanes[1] = buf[8];
+        state_.ca_byte11 = buf[11];
+        queue_type_a();
+    }
+
+    void process_type_b(const uint8_t* buf) {
+        state_.cb_byte1 = buf[1] & 0x3;
+        state_.cb_byte2 = buf[2];
+        if (buf[1] & 0x80) {
+            queue_type_b();
+        }
+    }
+
+    void send_init_dump() {
+        Message padding(MsgLen, 0);
+        queue(Message(capabilities_, capabilities_ + 12));
+        queue_type_a();
+        queue_type_b();
+        queue_type_c();
+        queue({0xCD});
+        queue({0xCE, 0x00});
+        queue_ce80();
+        queue_cf();
+        // The real unit sends zeroes (with invalid checksum) as padding between messages.
+        send_queue_.push_back(padding);
+        queue_status(false);
+    }
+
+    void queue_status(bool changed) {
+        uint8_t room = state_.thermistor == 1 ? uint8_t((state_.controller_temp - 10) * 2)
+                                              : uint8_t(lround((state_.unit_temp - 10) * 2));
+        Message msg(MsgLen, 0);
+        msg[0] = 0xC8;
+        msg[1] = (changed ? 0x1 : 0) | (state_.power ? 0x2 : 0) | (state_.mode << 2) | (state_.fan << 5);
+        msg[2] = state_.byte2;
+        msg[3] = (state_.defrost ? 0x4 : 0) | (state_.preheat ? 0x8 : 0) | (state_.reservation ? 0x10 : 0);
+        msg[4] = state_.mode == 4 ? 0x40 : 0;
+        msg[5] = (state_.setpoint_x2 & 1) | (state_.outdoor ? 0x4 : 0);
+        msg[6] = (state_.thermistor << 4) | ((state_.setpoint_x2 / 2 - 15) & 0xf);
+        msg[7] = (room & 0x3f) | (state_.power && state_.mode == 0 ? 0x40 : 0) |
+                 (state_.power && state_.mode == 4 ? 0x80 : 0);
+        msg[8] = state_.reservation ? state_.timer_byte8 : 0;
+        msg[9] = state_.reservation ? state_.timer_byte9 : 0;
+        msg[11] = state_.error;
+        queue(msg);
+        last_status_virtual_ = now();
+    }
+
+    void queue_type_a() {
+        Message msg(MsgLen, 0);
+        msg[0] = 0xCA;
+        msg[1] = state_.address;
+        memcpy(&msg[2], state_.fan_speeds, 5);
+        msg[7] = state_.vanes[0];
+        msg[8] = state_.vanes[1];
+        msg[10] = 0xf1;
+        msg[11] = state_.ca_byte11;
+        queue(msg);
+    }
+
+    void queue_type_b() {
+        Message msg(MsgLen, 0);
+        msg[0] = 0xCB;
+        msg[1] = state_.cb_byte1;
+        msg[2] = state_.cb_byte2;
+        msg[3] = pipe_temp_to_byte(state_.pipe_in);
+        msg[4] = pipe_temp_to_byte(state_.pipe_out);
+        msg[5] = pipe_temp_to_byte(state_.pipe_mid);
+        queue(msg);
+    }
+
+    void queue_type_c() {
+        // Filter time left and accumulated energy usage (BCD, 0.1 kWh).
+        uint32_t energy = uint32_t(state_.energy_kwh * 10) % 1000000;
+        Message msg(MsgLen, 0);
+        msg[0] = 0xCC;
+        msg[1] = 0xAB;
+        msg[2] = 0x01;
+        for (int i = 5; i >= 3; i--) {
+            msg[i] = uint8_t((energy % 10) | ((energy / 10 % 10) << 4));
+            energy /= 100;
+        }
+        msg[9] = uint8_t(lround(state_.unit_temp * 2));
+        queue(msg);
+    }
+
+    void queue_ce80() {
+        int temp_tenths = int(lround(state_.unit_temp * 10));
+        Message msg(MsgLen, 0);
+        msg[0] = 0xCE;
+        msg[1] = 0x80;
+        msg[2] = state_.humidity;
+        msg[10] = uint8_t(temp_tenths / 10);
+        msg[11] = uint8_t(temp_tenths % 10);
+        queue(msg);
+    }
+
+    void queue_cf() {
+        // Power usage in watts, BCD (see protocol.md).
+        uint32_t value = state_.power_watts % 1000000;
+        Message msg(MsgLen, 0);
+        msg[0] = 0xCF;
+        for (int i = 4; i >= 2; i--) {
+            msg[i] = uint8_t((value % 10) | ((value / 10 % 10) << 4));
+            value /= 100;
+        }
+        queue(msg);
+    }
+
+    // Very simple thermostat model: the outdoor unit runs if the room temperature is more than
+    // 0.5C away from the setpoint (in the right direction) and moves it 0.1C per minute.
+    void run_model() {
+        double t = now();
+        double elapsed_min = (t - last_model_virtual_) / 60000;
+        if (elapsed_min < 0.1) {
+            return;
+        }
+        last_model_virtual_ = t;
+
+        double room = state_.thermistor == 1 ? state_.controller_temp : state_.unit_temp;
+        double setpoint = state_.setpoint_x2 / 2.0;
+        bool heating = state_.mode == 4;
+        bool cooling = state_.mode == 0 || state_.mode == 1;
+        if (state_.outdoor_auto) {
+            bool need = state_.power && ((heating && room < setpoint - 0.5) || (cooling && room > setpoint + 0.5));
+            bool satisfied = !state_.power || (heating && room >= setpoint) || (cooling && room <= setpoint);
+            bool outdoor = need || (state_.outdoor && !satisfied);
+            if (outdoor != state_.outdoor) {
+                state_.outdoor = outdoor;
+                queue_status(false);
+            }
+        }
+
+        double drift = 0;
+        if (state_.outdoor && !state_.defrost) {
+            drift = heating ? 0.1 : -0.1;
+        } else {
+            // Drift toward 24C when idle.
+            drift = state_.unit_temp < 24 ? 0.02 : -0.02;
+        }
+        state_.unit_temp += drift * elapsed_min;
+        if (state_.outdoor_auto) {
+            state_.power_watts = state_.outdoor ? (state_.defrost ? 300 : 900) : (state_.power ? 30 : 2);
+            if (state_.outdoor) {
+                state_.pipe_in = heating ? 40 : 8;
+                state_.pipe_mid = heating ? 38 : 10;
+                state_.pipe_out = heating ? 30 : 14;
+            } else {
+                state_.pipe_in = state_.pipe_mid = state_.pipe_out = int(state_.unit_temp);
+            }
+        }
+        state_.energy_kwh += state_.power_watts / 1000.0 * elapsed_min / 60;
+    }
+
+    void run_timers() {
+        double t = now();
+        // Status every 60 seconds, followed by CE 80 and CF like newer units.
+        if (t - last_status_virtual_ > 60 * 1000 && send_queue_.empty()) {
+            queue_status(false);
+            queue_ce80();
+            queue_cf();
+        }
+    }
+
+    bool run_scenario() {
+        double t = now();
+        for (ScenarioEntry& entry : scenario_) {
+            if (entry.time < 0 || t < entry.time) {
+                continue;
+            }
+            printf("%s scenario: %s\n", timestamp().c_str(), entry.command.c_str());
+            if (!run_command(entry.command)) {
+                return false;
+            }
+            entry.time = entry.period > 0 ? entry.time + entry.period : -1;
+        }
+        return true;
+    }
+
+    bool run_command(const std::string& command) {
+        std::istringstream ss(command);
+        std::string name, arg;
+        ss >> name >> arg;
+        auto on = [&]() { return arg == "on" || arg == "1"; };
+        bool send_status = true;
+        if (name == "room_temp") {
+            state_.unit_temp = atof(arg.c_str());
+        } else if (name == "outdoor") {
+            state_.outdoor_auto = false;
+            state_.outdoor = on();
+        } else if (name == "auto") {
+            state_.outdoor_auto = true;
+        } else if (name == "defrost") {
+            state_.defrost = on();
+        } else if (name == "preheat") {
+            state_.preheat = on();
+        } else if (name == "error") {
+            state_.error = uint8_t(atoi(arg.c_str()));
+        } else if (name == "pipe") {
+            int value;
+            ss >> value;
+            send_status = false;
+            (arg == "in" ? state_.pipe_in : arg == "mid" ? state_.pipe_mid : state_.pipe_out) = value;
+        } else if (name == "power") {
+            state_.power_watts = uint32_t(atoi(arg.c_str()));
+            send_status = false;
+        } else if (name == "humidity") {
+            state_.humidity = uint8_t(atoi(arg.c_str()));
+            send_status = false;
+        } else if (name == "status") {
+            // Nothing to change.
+        } else if (name == "quit") {
+            return false;
+        } else {
+            fprintf(stderr, "Unknown scenario command: %s\n", command.c_str());
+            send_status = false;
+        }
+        if (send_status) {
+            queue_status(false);
+        }
+        return true;
+    }
+};
+
+int open_pty(const char* link) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    const char* slave = ptsname(fd);
+
+    // Put the slave side in raw mode so bytes are passed through unchanged.
+    int slave_fd = open(slave, O_RDWR | O_NOCTTY);
+    if (slave_fd >= 0) {
+        termios tio;
+        tcgetattr(slave_fd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave_fd, TCSANOW, &tio);
+        close(slave_fd);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    printf("pty: %s\n", slave);
+    if (link != nullptr) {
+        unlink(link);
+        if (symlink(slave, link) != 0) {
+            perror("symlink");
+            return -1;
+        }
+        printf("link: %s\n", link);
+    }
+    fflush(stdout);
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* link = nullptr;
+    const char* scenario = nullptr;
+    double speed = 1;
+    double duration = 0;
+    bool wire_delay = true;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--link" && has_value) {
+            link = argv[++i];
+        } else if (arg == "--speed" && has_value) {
+            speed = atof(argv[++i]);
+        } else if (arg == "--scenario" && has_value) {
+            scenario = argv[++i];
+        } else if (arg == "--duration" && has_value) {
+            duration = atof(argv[++i]) * 1000;
+        } else if (arg == "--no-wire-delay") {
+            wire_delay = false;
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--link PATH] [--speed N] [--scenario FILE] [--duration SECS] "
+                            "[--no-wire-delay] [--quiet]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (speed <= 0) {
+        fprintf(stderr, "Invalid speed\n");
+        return 1;
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    int fd = open_pty(link);
+    if (fd < 0) {
+        return 1;
+    }
+
+    Emulator emulator(fd, speed, wire_delay, quiet);
+    if (scenario != nullptr && !emulator.load_scenario(scenario)) {
+        return 1;
+    }
+    emulator.run(duration);
+
+    if (link != nullptr) {
+        unlink(link);
+    }
+    close(fd);
+    return 0;
+}
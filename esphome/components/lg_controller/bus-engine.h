@@ -0,0 +1,575 @@
+#pragma once
+
+// Low-level bus handling: splitting received bytes into messages and sending queued messages when
+// the line is idle. On ESP32 this runs in its own FreeRTOS task so bus timing doesn't depend on
+// the ESPHome main loop (WiFi reconnects, OTA, API traffic). Elsewhere, LgController::loop polls
+// it. Either way, LgController only talks to it through SPSC queues.
+//
+// SendScheduler decides which of the controller's messages are sent and in what order.
+//
+// This doesn't depend on ESPHome (except for the ESP32 task), so tools/lg-latency.cpp can run it
+// against a simulated bus.
+
+#include <atomic>
+#include <cstring>
+
+#include "lg-protocol.h"
+#include "spsc-queue.h"
+
+#ifdef USE_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "esphome/core/hal.h"
+#endif
+
+namespace esphome::lg_controller {
+
+// Byte-level access to the bus.
+class BusIo {
+public:
+    virtual ~BusIo() = default;
+    virtual int available() = 0;
+    virtual bool read_byte(uint8_t* data) = 0;
+    virtual void write_array(const uint8_t* data, size_t len) = 0;
+    // Returns true if a byte is being transmitted right now (RX pin low). This is optional, but
+    // it's much faster than waiting for a full byte to arrive.
+    virtual bool line_active() {
+        return false;
+    }
+};
+
+enum class BusEventKind : uint8_t {
+    Received,   // Complete message received (this includes the echo of our own messages).
+    Sent,       // Queued message was written to the UART.
+    Dropped,    // Queued message wasn't sent because the line stayed busy for too long or
+                // the engine is listen-only.
+    Discarded,  // Incomplete data was discarded, `len` is less than MsgLen.
+};
+
+struct BusEvent {
+    BusEventKind kind;
+    uint8_t len;
+    uint32_t millis;
+    uint8_t data[MsgLen];
+};
+
+class BusEngine {
+    struct OutgoingMessage {
+        uint32_t queued_millis;
+        uint8_t data[MsgLen];
+    };
+
+    // A 13-byte message takes about 1.25 seconds at 104 bps. Events are consumed from the main
+    // loop, so this has plenty of room.
+    SpscQueue<OutgoingMessage, 8> outgoing_;
+    // Sent before the messages in `outgoing_` in the next idle window.
+    SpscQueue<OutgoingMessage, 2> priority_;
+    SpscQueue<BusEvent, 32> events_;
+    std::atomic<uint32_t> lost_events_{0};
+
+    // If set, nothing is ever written to the bus. Queued messages are dropped.
+    std::atomic<bool> listen_only_{false};
+
+    BusIo* io_ = nullptr;
+
+    // Only accessed by poll().
+    uint8_t recv_buf_[MsgLen] = {};
+    uint8_t recv_buf_len_ = 0;
+    uint32_t last_recv_millis_ = 0;
+    uint32_t last_activity_millis_ = 0;
+
+#ifdef USE_ESP32
+    TaskHandle_t task_ = nullptr;
+
+    static void task_func(void* arg) {
+        BusEngine* engine = static_cast<BusEngine*>(arg);
+        while (true) {
+            engine->poll(esphome::millis());
+            vTaskDelay(pdMS_TO_TICKS(PollIntervalMillis));
+        }
+    }
+#endif
+
+    // Sends or drops queued messages. Returns false if a message is still waiting for the line.
+    template <typename Queue>
+    bool flush_queue(Queue& queue, bool idle, bool listen_only, uint32_t now) {
+        while (OutgoingMessage* msg = queue.front()) {
+            if (idle && !listen_only) {
+                io_->write_array(msg->data, MsgLen);
+                push_event(BusEventKind::Sent, msg->data, MsgLen, now);
+            } else if (listen_only || now - msg->queued_millis > MaxQueuedMillis) {
+                push_event(BusEventKind::Dropped, msg->data, MsgLen, now);
+            } else {
+                return false;
+            }
+            queue.pop();
+        }
+        return true;
+    }
+
+    void push_event(BusEventKind kind, const uint8_t* data, uint8_t len, uint32_t now) {
+        BusEvent event;
+        event.kind = kind;
+        event.len = len;
+        event.millis = now;
+        memcpy(event.data, data, len);
+        if (!events_.push(event)) {
+            lost_events_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    // Make sure the RX pin is idle for at least 500 ms to avoid collisions on the bus as much as
+    // possible. If there is still a collision, we'll likely both start sending at approximately
+    // the same time and the message will hopefully be corrupt (and ignored) anyway. Else the
+    // in-flight mechanism in LgController should catch it and we try again.
+    //
+    // 500 ms might be overkill, but the device usually sends the same message twice with a short
+    // delay (about 200 ms?) between them so let's not send there either to avoid collisions.
+    static constexpr uint32_t IdleMillis = 500;
+
+    // Queued messages are dropped if the line isn't idle within this time. LgController then
+    // sends a new message with the current state instead.
+    static constexpr uint32_t MaxQueuedMillis = 5000;
+
+    static constexpr uint32_t DiscardIncompleteMillis = 15 * 1000;
+
+    // A bit takes about 9.6 ms at 104 bps, so polling the RX pin every 5 ms doesn't miss start
+    // bits.
+    static constexpr uint32_t PollIntervalMillis = 5;
+
+    void init(BusIo* io, uint32_t now) {
+        io_ = io;
+        // Wait for a full idle period before sending the first message.
+        last_activity_millis_ = now;
+    }
+
+    // Starts the bus task. After this, only the task may access the UART. Returns false if the
+    // task can't be created (or isn't supported on this platform) and poll() must be called every
+    // few milliseconds instead.
+    bool start_task() {
+#ifdef USE_ESP32
+        if (task_ != nullptr) {
+            return true;
+        }
+        // Run on the same core as the main loop (the last one), away from the WiFi stack. The
+        // task sleeps between polls so it doesn't starve the main loop.
+        BaseType_t res = xTaskCreatePinnedToCore(task_func, "lg_bus", 3072, this, 5, &task_,
+                                                 portNUM_PROCESSORS - 1);
+        if (res != pdPASS) {
+            task_ = nullptr;
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void set_listen_only(bool listen_only) {
+        listen_only_.store(listen_only, std::memory_order_relaxed);
+    }
+
+    // Producer side of the outgoing queue, called by LgController.
+    bool queue_message(const uint8_t* data, uint32_t now) {
+        OutgoingMessage msg;
+        msg.queued_millis = now;
+        memcpy(msg.data, data, MsgLen);
+        return outgoing_.push(msg);
+    }
+
+    // Like queue_message, but the message skips the messages already queued.
+    bool queue_priority_message(const uint8_t* data, uint32_t now) {
+        OutgoingMessage msg;
+        msg.queued_millis = now;
+        memcpy(msg.data, data, MsgLen);
+        return priority_.push(msg);
+    }
+
+    // Consumer side of the event queue, called by LgController.
+    bool pop_event(BusEvent* event) {
+        return events_.pop(event);
+    }
+
+    // Returns and resets the number of events lost because the event queue was full.
+    uint32_t take_lost_events() {
+        return lost_events_.exchange(0, std::memory_order_relaxed);
+    }
+
+    void poll(uint32_t now) {
+        while (io_->available() > 0) {
+            if (!io_->read_byte(&recv_buf_[recv_buf_len_])) {
+                break;
+            }
+            last_recv_millis_ = now;
+            last_activity_millis_ = now;
+            recv_buf_len_++;
+            if (recv_buf_len_ == MsgLen) {
+                push_event(BusEventKind::Received, recv_buf_, MsgLen, now);
+                recv_buf_len_ = 0;
+            }
+        }
+
+        if (io_->line_active()) {
+            last_activity_millis_ = now;
+        }
+
+        if (recv_buf_len_ > 0 && now - last_recv_millis_ > DiscardIncompleteMillis) {
+            push_event(BusEventKind::Discarded, recv_buf_, recv_buf_len_, now);
+            recv_buf_len_ = 0;
+        }
+
+        // Send all queued messages back to back in the same idle window, priority messages first.
+        bool listen_only = listen_only_.load(std::memory_order_relaxed);
+        bool idle = recv_buf_len_ == 0 && now - last_activity_millis_ >= IdleMillis;
+        if (flush_queue(priority_, idle, listen_only, now)) {
+            flush_queue(outgoing_, idle, listen_only, now);
+        }
+    }
+};
+
+// Messages we sent but didn't receive back yet. Because the bus is a single wire, we receive our
+// own messages too. If one of these wasn't received back within EchoTimeoutMillis after the bus
+// engine sent it, it was likely corrupted and only that message is sent again. Messages of 6 bytes
+// are stored followed by zeroes, like in BusEvent.
+template <typename Kind>
+class InFlightTable {
+public:
+    static constexpr size_t MaxMessages = 3;
+
+    // Messages in a burst are written back to back, so the last echo can take a few message
+    // times to arrive. A 13-byte message takes about 1.25 seconds at 104 bps.
+    static constexpr uint32_t EchoTimeoutMillis = 4 * MsgLen * 10 * 1000 / 104;
+
+    struct Entry {
+        uint8_t data[MsgLen];
+        Kind kind;
+        bool sent;
+        uint32_t sent_millis;
+    };
+
+private:
+    Entry entries_[MaxMessages] = {};
+    size_t size_ = 0;
+
+    void remove(size_t index) {
+        for (size_t j = index + 1; j < size_; j++) {
+            entries_[j - 1] = entries_[j];
+        }
+        size_--;
+    }
+
+    // Returns the index of the first matching message, or -1.
+    int find(const uint8_t* data, bool unsent_only) const {
+        for (size_t i = 0; i < size_; i++) {
+            if ((!unsent_only || !entries_[i].sent) && memcmp(entries_[i].data, data, MsgLen) == 0) {
+                return int(i);
+            }
+        }
+        return -1;
+    }
+
+public:
+    bool empty() const {
+        return size_ == 0;
+    }
+    bool full() const {
+        return size_ == MaxMessages;
+    }
+
+    bool contains(Kind kind) const {
+        for (size_t i = 0; i < size_; i++) {
+            if (entries_[i].kind == kind) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns false if the table is full.
+    bool add(const uint8_t* data, Kind kind) {
+        if (full()) {
+            return false;
+        }
+        Entry& entry = entries_[size_++];
+        memcpy(entry.data, data, MsgLen);
+        entry.kind = kind;
+        entry.sent = false;
+        entry.sent_millis = 0;
+        return true;
+    }
+
+    // For BusEventKind::Sent. Returns the kind of the message if it was ours.
+    bool mark_sent(const uint8_t* data, uint32_t now, Kind* kind) {
+        int index = find(data, /* unsent_only = */ true);
+        if (index < 0) {
+            return false;
+        }
+        entries_[index].sent = true;
+        entries_[index].sent_millis = now;
+        *kind = entries_[index].kind;
+        return true;
+    }
+
+    // For BusEventKind::Dropped. Removes the unsent message and returns its kind.
+    bool take_unsent(const uint8_t* data, Kind* kind) {
+        int index = find(data, /* unsent_only = */ true);
+        if (index < 0) {
+            return false;
+        }
+        *kind = entries_[index].kind;
+        remove(index);
+        return true;
+    }
+
+    // For received messages. Returns true and removes the message if we sent it.
+    bool take(const uint8_t* data, Kind* kind) {
+        int index = find(data, /* unsent_only = */ false);
+        if (index < 0) {
+            return false;
+        }
+        *kind = entries_[index].kind;
+        remove(index);
+        return true;
+    }
+
+    // Removes a message that wasn't received back in time. Call this until it returns false.
+    bool take_expired(uint32_t now, Entry* entry) {
+        for (size_t i = 0; i < size_; i++) {
+            if (entries_[i].sent && now - entries_[i].sent_millis > EchoTimeoutMillis) {
+                *entry = entries_[i];
+                remove(i);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Messages sent by a controller, as stored in the in-flight table.
+enum class PendingSendKind : uint8_t { None, Status, TypeA, TypeB, Installer5, Installer6 };
+
+// Decides which messages are due and queues them as one burst, in this order: the status message,
+// the Type A (0xAA) message, the Type B (0xAB) message and the installer settings (0xAD, 0xAE 10)
+// messages. Messages in a burst are sent back to back in the next idle window and the next burst
+// waits until all of them have been verified (or timed out).
+//
+// It also handles two cases where messages belong together:
+//
+// - A preset transaction: the status, Type A and Type B messages for a climate preset. If any of
+//   them isn't verified, all of them are sent again (up to MaxPresetAttempts bursts) so the unit
+//   doesn't end up with a mix of old and new settings.
+// - Priority messages (a DRED change) that skip the burst and the messages already queued in the
+//   bus engine.
+//
+// The owner builds the messages and calls retry() for messages that weren't sent or verified.
+class SendScheduler {
+public:
+    using InFlight = InFlightTable<PendingSendKind>;
+    static constexpr size_t MaxBurst = InFlight::MaxMessages;
+    static constexpr uint8_t MaxPresetAttempts = 3;
+    static constexpr uint32_t StatusIntervalMillis = 20 * 1000;
+
+    // State from the owner that affects which messages are due.
+    struct Conditions {
+        // Don't follow a status change with a Type A message yet (the unit's 0xCA message wasn't
+        // received).
+        bool initializing = false;
+        // A room temperature change may be sent (rate limited by the owner).
+        bool room_temp_push = false;
+        // The timed Type B message requesting pipe temperatures is due.
+        bool pipe_temp_poll = false;
+    };
+
+    struct Burst {
+        PendingSendKind kinds[MaxBurst];
+        size_t size = 0;
+        // The status message has the changed flag set.
+        bool status_change = false;
+        // The status message is only sent for a room temperature change, so it uses a token.
+        bool room_temp_push = false;
+        // The status change is followed by a Type A message with our vane positions.
+        bool vane_follow_up = false;
+        // The Type B message is the timed pipe temperature request, not a settings change.
+        bool timed_type_b = false;
+
+        bool empty() const {
+            return size == 0;
+        }
+    };
+
+    enum class RetryResult : uint8_t {
+        None,         // Not part of a preset transaction, or already being sent again.
+        PresetRetry,  // The preset's messages are all sent again.
+        PresetFailed, // The preset wasn't applied after MaxPresetAttempts bursts.
+    };
+
+private:
+    uint8_t pending_ = 0;  // Bitmask of kind_bit().
+    bool vane_follow_up_ = false;
+    bool periodic_status_ = true;
+    uint32_t last_status_millis_ = 0;
+
+    uint8_t preset_kinds_ = 0;  // Bitmask of kind_bit(), 0 if no preset is being applied.
+    uint8_t preset_unverified_ = 0;
+    uint8_t preset_attempts_ = 0;
+    bool preset_queued_ = false;  // The current attempt was queued.
+
+    static uint8_t kind_bit(PendingSendKind kind) {
+        return 1 << uint8_t(kind);
+    }
+
+    void take(Burst* burst, PendingSendKind kind) {
+        burst->kinds[burst->size++] = kind;
+        pending_ &= ~kind_bit(kind);
+    }
+
+public:
+    // Slave controllers only send a status message when settings are changed.
+    void set_periodic_status(bool periodic_status) {
+        periodic_status_ = periodic_status;
+    }
+    // The regular status message is sent StatusIntervalMillis after this.
+    void set_last_status_millis(uint32_t now) {
+        last_status_millis_ = now;
+    }
+
+    // A setting changed, so a message of this kind must be sent.
+    void request(PendingSendKind kind) {
+        pending_ |= kind_bit(kind);
+    }
+    void clear(PendingSendKind kind) {
+        pending_ &= ~kind_bit(kind);
+    }
+    bool is_pending(PendingSendKind kind) const {
+        return (pending_ & kind_bit(kind)) != 0;
+    }
+
+    // A mode or swing change resets the vanes on the unit, so the next status change is followed
+    // by a Type A message with our vane positions.
+    void request_vane_follow_up() {
+        vane_follow_up_ = true;
+    }
+
+    // Drops all pending messages, for controllers that never send.
+    void discard() {
+        pending_ = 0;
+        vane_follow_up_ = false;
+    }
+
+    // Sends a message of this kind again because it wasn't sent or verified. If it's part of the
+    // preset being applied, all of the preset's messages are sent again.
+    RetryResult retry(PendingSendKind kind) {
+        pending_ |= kind_bit(kind);
+        if ((preset_unverified_ & kind_bit(kind)) == 0) {
+            return RetryResult::None;
+        }
+        RetryResult result = RetryResult::None;
+        if (preset_queued_) {
+            // First failure for this attempt.
+            preset_queued_ = false;
+            if (preset_attempts_ >= MaxPresetAttempts) {
+                preset_kinds_ = 0;
+                preset_unverified_ = 0;
+                return RetryResult::PresetFailed;
+            }
+            result = RetryResult::PresetRetry;
+        }
+        preset_unverified_ = preset_kinds_;
+        pending_ |= preset_kinds_;
+        return result;
+    }
+
+    // A message of this kind was received back. Returns true if this completes the preset.
+    bool verified(PendingSendKind kind) {
+        if ((preset_unverified_ & kind_bit(kind)) == 0) {
+            return false;
+        }
+        preset_unverified_ &= ~kind_bit(kind);
+        if (preset_unverified_ != 0) {
+            return false;
+        }
+        preset_kinds_ = 0;
+        return true;
+    }
+
+    // Starts tracking the messages that are now pending (except for installer settings) as one
+    // preset transaction.
+    void begin_preset(bool initializing) {
+        uint8_t kinds = pending_ & (kind_bit(PendingSendKind::Status) | kind_bit(PendingSendKind::TypeA) |
+                                    kind_bit(PendingSendKind::TypeB));
+        if (vane_follow_up_ && !initializing) {
+            kinds |= kind_bit(PendingSendKind::TypeA);
+        }
+        preset_kinds_ = kinds;
+        preset_unverified_ = kinds;
+        preset_attempts_ = 0;
+        preset_queued_ = false;
+    }
+    uint8_t preset_attempts() const {
+        return preset_attempts_;
+    }
+
+    // For a priority message: returns true if the owner should send it right away (and queue it
+    // with BusEngine::queue_priority_message), else it's sent with the next burst. `ready` is
+    // false if the owner can't build the message yet.
+    bool send_priority(PendingSendKind kind, bool ready, const InFlight& in_flight) {
+        if (!ready || in_flight.full()) {
+            request(kind);
+            return false;
+        }
+        clear(kind);
+        return true;
+    }
+
+    // Returns the messages to send now. Nothing is sent until the previous burst has been
+    // verified. The pending flags for the returned messages are cleared.
+    Burst next_burst(uint32_t now, const Conditions& conditions, const InFlight& in_flight) {
+        Burst burst;
+        if (!in_flight.empty()) {
+            return burst;
+        }
+
+        // Pending changes, a room temperature change or the regular status message.
+        bool status_change = is_pending(PendingSendKind::Status);
+        bool periodic_status = periodic_status_ && now - last_status_millis_ > StatusIntervalMillis;
+        if (status_change || conditions.room_temp_push || periodic_status) {
+            take(&burst, PendingSendKind::Status);
+            burst.status_change = status_change;
+            burst.room_temp_push = !status_change && !periodic_status;
+            last_status_millis_ = now;
+            // When initializing, wait for the unit's CA message first.
+            if (status_change && !conditions.initializing && vane_follow_up_) {
+                burst.vane_follow_up = true;
+                request(PendingSendKind::TypeA);
+            }
+            vane_follow_up_ = false;
+        }
+        if (is_pending(PendingSendKind::TypeA)) {
+            take(&burst, PendingSendKind::TypeA);
+        }
+        // Pending changes take priority over the timed AB message, but both use the same
+        // message.
+        if (is_pending(PendingSendKind::TypeB)) {
+            take(&burst, PendingSendKind::TypeB);
+        } else if (conditions.pipe_temp_poll) {
+            take(&burst, PendingSendKind::TypeB);
+            burst.timed_type_b = true;
+        }
+        // Installer settings are rarely changed. If the burst is already full, they're sent
+        // with the next one.
+        for (PendingSendKind kind : {PendingSendKind::Installer5, PendingSendKind::Installer6}) {
+            if (is_pending(kind) && burst.size < MaxBurst) {
+                take(&burst, kind);
+            }
+        }
+
+        if (!burst.empty() && preset_kinds_ != 0 && !preset_queued_) {
+            preset_queued_ = true;
+            preset_attempts_++;
+        }
+        return burst;
+    }
+};
+
+} // namespace esphome::lg_controller
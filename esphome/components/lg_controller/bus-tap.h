@@ -0,0 +1,145 @@
+#pragma once
+
+// Sends all messages on the bus to a UDP collector, for example `lg-capture listen`. Messages are
+// batched into datagrams (see TapHeader in lg-protocol.h) to keep the overhead low.
+
+#include "esphome.h"
+
+#include "lg-protocol.h"
+
+#if defined(USE_ESP32) || defined(USE_HOST)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define LG_BUS_TAP_SUPPORTED
+#endif
+
+namespace esphome::lg_controller {
+
+class BusTap {
+    uint32_t address_ = 0;     // IPv4, network byte order
+    uint16_t port_ = 0;        // 0: disabled
+    uint32_t max_delay_millis_ = 5000;
+
+    // Records are written directly into the datagram we send.
+    struct Datagram {
+        TapHeader header;
+        CaptureRecord records[MaxTapRecords];
+    };
+    Datagram datagram_{};
+    uint32_t first_record_millis_ = 0;
+    uint32_t sequence_ = 0;
+    uint32_t dropped_ = 0;
+
+    // The bus engine's 32-bit event timestamps, extended to 64 bits. Events arrive in order, so
+    // a smaller timestamp means millis() wrapped around.
+    uint32_t last_event_millis_ = 0;
+    uint64_t millis_high_ = 0;
+
+#ifdef LG_BUS_TAP_SUPPORTED
+    int fd_ = -1;
+#endif
+
+public:
+    static bool supported() {
+#ifdef LG_BUS_TAP_SUPPORTED
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool enabled() const {
+        return port_ != 0;
+    }
+
+    // The address is validated by the YAML config.
+    void configure(const char* address, uint16_t port, uint32_t max_delay_millis) {
+#ifdef LG_BUS_TAP_SUPPORTED
+        in_addr addr;
+        if (inet_aton(address, &addr) == 0) {
+            return;
+        }
+        address_ = addr.s_addr;
+#endif
+        port_ = port;
+        max_delay_millis_ = max_delay_millis;
+    }
+
+    // `event_millis` is the BusEvent timestamp, when the message was on the bus.
+    void add(CaptureDirection direction, const uint8_t* data, uint32_t event_millis) {
+        if (!enabled()) {
+            return;
+        }
+        uint16_t count = datagram_.header.count;
+        if (count == 0) {
+            first_record_millis_ = millis();
+        }
+        CaptureRecord& rec = datagram_.records[count];
+        rec.timestamp_micros = millis64(event_millis) * 1000;
+        rec.direction = uint8_t(direction);
+        rec.flags = 0;
+        memcpy(rec.data, data, MsgLen);
+        rec.padding = 0;
+        datagram_.header.count = count + 1;
+        if (datagram_.header.count == MaxTapRecords) {
+            flush();
+        }
+    }
+
+    // Send the pending records if the oldest one has been waiting for max_delay.
+    void loop(uint32_t now) {
+        if (datagram_.header.count > 0 && now - first_record_millis_ >= max_delay_millis_) {
+            flush();
+        }
+    }
+
+private:
+    uint64_t millis64(uint32_t event_millis) {
+        if (event_millis < last_event_millis_) {
+            millis_high_ += uint64_t(1) << 32;
+        }
+        last_event_millis_ = event_millis;
+        return millis_high_ | event_millis;
+    }
+
+    void flush() {
+        uint16_t count = datagram_.header.count;
+        datagram_.header.count = 0;
+#ifdef LG_BUS_TAP_SUPPORTED
+        if (fd_ < 0) {
+            // Created on first use because the network isn't up yet in setup().
+            fd_ = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (fd_ < 0) {
+                dropped_ += count;
+                return;
+            }
+        }
+        TapHeader& header = datagram_.header;
+        memcpy(header.magic, "LGTP", 4);
+        header.version = TapVersion;
+        header.record_size = sizeof(CaptureRecord);
+        header.sequence = sequence_++;
+        header.count = count;
+        header.dropped = std::min<uint32_t>(dropped_, UINT16_MAX);
+
+        sockaddr_in dest{};
+        dest.sin_family = AF_INET;
+        dest.sin_port = htons(port_);
+        dest.sin_addr.s_addr = address_;
+        size_t len = sizeof(TapHeader) + count * sizeof(CaptureRecord);
+        if (::sendto(fd_, &datagram_, len, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&dest),
+                     sizeof(dest)) == ssize_t(len)) {
+            dropped_ = 0;
+        } else {
+            dropped_ += count;
+        }
+        header.count = 0;
+#else
+        dropped_ += count;
+#endif
+    }
+};
+
+} // namespace esphome::lg_controller
@@ -1,12 +1,32 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import pins
-from esphome.components import binary_sensor, climate, number, select, sensor, switch, uart
-from esphome.const import CONF_ID, CONF_RX_PIN
+from esphome.components import binary_sensor, climate, number, select, sensor, switch, text_sensor, uart
+from esphome.const import (
+    CONF_ADDRESS,
+    CONF_ENERGY,
+    CONF_ID,
+    CONF_MAX,
+    CONF_MIN,
+    CONF_PORT,
+    CONF_POWER,
+    CONF_RX_PIN,
+    DEVICE_CLASS_DURATION,
+    DEVICE_CLASS_ENERGY,
+    DEVICE_CLASS_POWER,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_KELVIN,
+    UNIT_KILOWATT_HOURS,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
+    UNIT_SECOND,
+    UNIT_WATT,
+)
 
 CODEOWNERS = ["JanM321"]
 DEPENDENCIES = ["uart"]
-AUTO_LOAD = ["binary_sensor", "number", "switch", "sensor", "select"]
+AUTO_LOAD = ["binary_sensor", "number", "switch", "sensor", "select", "text_sensor"]
 
 lg_controller_ns = cg.esphome_ns.namespace("lg_controller")
 LgController = lg_controller_ns.class_(
@@ -20,6 +40,12 @@ CONF_FAHRENHEIT = "fahrenheit"
 CONF_IS_SLAVE_CONTROLLER = "is_slave_controller"
 
 CONF_TEMPERATURE_SENSOR = "temperature_sensor"
+CONF_TEMPERATURE_SENSORS = "temperature_sensors"
+CONF_TEMPERATURE_FUSION = "temperature_fusion"
+CONF_ROOM_TEMPERATURE_STALE = "room_temperature_stale"
+CONF_SENSOR = "sensor"
+CONF_MAX_AGE = "max_age"
+CONF_WEIGHT = "weight"
 
 CONF_VANE1 = "vane1"
 CONF_VANE2 = "vane2"
@@ -33,7 +59,14 @@ CONF_FAN_SPEED_MEDIUM = "fan_speed_medium"
 CONF_FAN_SPEED_HIGH = "fan_speed_high"
 CONF_SLEEP_TIMER = "sleep_timer"
 
+CONF_BUS_TASK = "bus_task"
+CONF_PASSIVE = "passive"
+
+CONF_UNIT_ADDRESS = "unit_address"
+CONF_GROUP_UNITS = "group_units"
+
 CONF_ERROR_CODE = "error_code"
+CONF_ERROR_HISTORY = "error_history"
 CONF_PIPE_TEMP_IN = "pipe_temp_in"
 CONF_PIPE_TEMP_MID = "pipe_temp_mid"
 CONF_PIPE_TEMP_OUT = "pipe_temp_out"
@@ -47,53 +80,448 @@ CONF_PURIFIER = "purifier"
 CONF_INTERNAL_THERMISTOR = "internal_thermistor"
 CONF_AUTO_DRY = "auto_dry"
 
+CONF_ROOM_TEMP_HYSTERESIS = "room_temp_hysteresis"
+CONF_DWELL = "dwell"
+
+CONF_ROOM_TEMP_PUSH = "room_temp_push"
+CONF_BURST = "burst"
+CONF_REFILL_INTERVAL = "refill_interval"
+
+CONF_TEMPERATURE_COMPENSATION = "temperature_compensation"
+CONF_HEAT_OFFSETS = "heat_offsets"
+CONF_COOL_OFFSETS = "cool_offsets"
+CONF_TEMPERATURE = "temperature"
+CONF_OFFSET = "offset"
+CONF_KP = "kp"
+CONF_KI = "ki"
+CONF_MAX_CORRECTION = "max_correction"
+
+CONF_PUBLISH_INTERVAL = "publish_interval"
+CONF_SAVE_INTERVAL = "save_interval"
+
+CONF_COIL_ANALYTICS = "coil_analytics"
+CONF_DELTA_T_COOLING = "delta_t_cooling"
+CONF_DELTA_T_HEATING = "delta_t_heating"
+CONF_DRIFT = "drift"
+CONF_DEFROST_COUNT = "defrost_count"
+CONF_DEFROST_DURATION = "defrost_duration"
+CONF_OUTDOOR_DUTY_CYCLE = "outdoor_duty_cycle"
+CONF_OUTDOOR_STARTS = "outdoor_starts"
+
+CONF_ZONES = "zones"
+CONF_ZONE = "zone"
+CONF_ZONE_BATCH_DELAY = "zone_batch_delay"
+
+CONF_DRED = "dred"
+CONF_DRED_STATE = "dred_state"
+CONF_DRED_LATENCY = "dred_latency"
+
+CONF_PRESETS = "presets"
+CONF_PRESET = "preset"
+CONF_MODE = "mode"
+CONF_TARGET_TEMPERATURE = "target_temperature"
+CONF_FAN_MODE = "fan_mode"
+CONF_SWING_MODE = "swing_mode"
+
+CONF_INSTALLER_SETTINGS = "installer_settings"
+CONF_SETTING = "setting"
+
+CONF_BUS_TAP = "bus_tap"
+CONF_MAX_DELAY = "max_delay"
+
+CONF_AGGREGATE = "aggregate"
+CONF_WINDOW = "window"
+CONF_STATISTIC = "statistic"
+CONF_THRESHOLD = "threshold"
+
+CONF_PIPE_TEMP_POLL = "pipe_temp_poll"
+CONF_ACTIVE_INTERVAL = "active_interval"
+CONF_IDLE_INTERVAL = "idle_interval"
+CONF_ACTIVE_HOLD = "active_hold"
+CONF_BUS_BUDGET = "bus_budget"
+
 VANE_OPTIONS = ["0 (Default)", "1 (Up)", "2", "3", "4", "5", "6 (Down)"]
+DRED_OPTIONS = ["Off", "DRM 1", "DRM 2", "DRM 3"]
 OVERHEATING_OPTIONS = ["0 (Default)", "1 (+4C/+6C)", "2 (+2C/+4C)", "3 (-1C/+1C)", "4 (-0.5C/+0.5C)"]
 
-CONFIG_SCHEMA = climate.climate_schema(LgController).extend(
+# Order must match the TempFusion enum.
+TEMPERATURE_FUSION_OPTIONS = {
+    "median": 0,
+    "mean": 1,
+    "weighted_mean": 2,
+    "min": 3,
+    "max": 4,
+}
+
+# Order must match the SensorWindow::Statistic enum.
+AGGREGATE_STATISTIC_OPTIONS = {
+    "mean": 0,
+    "min": 1,
+    "max": 2,
+    "last": 3,
+}
+
+AGGREGATE_SCHEMA = cv.Schema(
     {
-        cv.Required(CONF_RX_PIN): pins.gpio_input_pin_schema,
-
-        cv.Required(CONF_FAHRENHEIT): cv.boolean,
-        cv.Required(CONF_IS_SLAVE_CONTROLLER): cv.boolean,
-
-        cv.Optional(CONF_TEMPERATURE_SENSOR): cv.use_id(sensor.Sensor),
-
-        cv.Required(CONF_VANE1): select.select_schema(LgSelect),
-        cv.Required(CONF_VANE2): select.select_schema(LgSelect),
-        cv.Required(CONF_VANE3): select.select_schema(LgSelect),
-        cv.Required(CONF_VANE4): select.select_schema(LgSelect),
-        cv.Required(CONF_OVERHEATING): select.select_schema(LgSelect),
-
-        cv.Required(CONF_FAN_SPEED_SLOW): number.number_schema(LgNumber),
-        cv.Required(CONF_FAN_SPEED_LOW): number.number_schema(LgNumber),
-        cv.Required(CONF_FAN_SPEED_MEDIUM): number.number_schema(LgNumber),
-        cv.Required(CONF_FAN_SPEED_HIGH): number.number_schema(LgNumber),
-        cv.Required(CONF_SLEEP_TIMER): number.number_schema(LgNumber),
-
-        cv.Required(CONF_ERROR_CODE): sensor.sensor_schema(),
-        cv.Required(CONF_PIPE_TEMP_IN): sensor.sensor_schema(),
-        cv.Required(CONF_PIPE_TEMP_MID): sensor.sensor_schema(),
-        cv.Required(CONF_PIPE_TEMP_OUT): sensor.sensor_schema(),
-
-        cv.Required(CONF_DEFROST): binary_sensor.binary_sensor_schema(),
-        cv.Required(CONF_PREHEAT): binary_sensor.binary_sensor_schema(),
-        cv.Required(CONF_OUTDOOR): binary_sensor.binary_sensor_schema(),
-        cv.Required(CONF_AUTO_DRY_ACTIVE): binary_sensor.binary_sensor_schema(),
-
-        cv.Required(CONF_PURIFIER): switch.switch_schema(LgSwitch),
-        cv.Required(CONF_INTERNAL_THERMISTOR): switch.switch_schema(LgSwitch),
-        cv.Required(CONF_AUTO_DRY): switch.switch_schema(LgSwitch),
+        cv.Required(CONF_WINDOW): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_STATISTIC, default="mean"): cv.enum(AGGREGATE_STATISTIC_OPTIONS, lower=True),
+        # Publish immediately if a sample differs this much from the last published value. 0 disables this.
+        cv.Optional(CONF_THRESHOLD, default=0.0): cv.positive_float,
+        cv.Optional(CONF_MIN): sensor.sensor_schema(),
+        cv.Optional(CONF_MAX): sensor.sensor_schema(),
     }
-).extend(cv.COMPONENT_SCHEMA).extend(uart.UART_DEVICE_SCHEMA)
+)
 
-async def to_code(config):
-    rx_pin = await cg.gpio_pin_expression(config[CONF_RX_PIN])
 
-    if CONF_TEMPERATURE_SENSOR in config:
-        temperature_sensor = await cg.get_variable(config[CONF_TEMPERATURE_SENSOR])
+# Supported installer settings and their maximum value. Must match InstallerSettingFields.
+INSTALLER_SETTINGS = {
+    25: 1,   # Auxiliary heater
+    36: 1,   # Use primary heater control
+    38: 1,   # Fan interlocked with ventilation
+    39: 1,   # Indoor unit auto start
+    41: 15,  # Simple dry contact setting
+    46: 1,   # Fan continuous
+    47: 1,   # Outdoor unit function
+    48: 15,  # Silent mode
+    49: 15,  # Defrost mode
+    51: 1,   # Temperature-based fan speed auto
+    52: 15,  # CN_EXT setting
+    56: 31,  # Outdoor unit cycle priority (raw value)
+    57: 1,   # Outdoor temp for heating stages
+    60: 1,   # Outdoor unit cycle priority (special)
+}
+
+INSTALLER_SETTING_SCHEMA = number.number_schema(LgNumber, entity_category="config").extend(
+    {
+        cv.Required(CONF_SETTING): cv.one_of(*INSTALLER_SETTINGS, int=True),
+    }
+)
+
+
+BUS_TAP_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Required(CONF_ADDRESS): cv.ipv4address,
+            cv.Optional(CONF_PORT, default=5140): cv.port,
+            # Pending messages are sent when a datagram is full or after this delay.
+            cv.Optional(CONF_MAX_DELAY, default="5s"): cv.positive_time_period_milliseconds,
+        }
+    ),
+    cv.only_on(["esp32", "host"]),
+)
+
+ZONE_SCHEMA = switch.switch_schema(LgSwitch).extend(
+    {
+        cv.Required(CONF_ZONE): cv.int_range(min=1, max=8),
+    }
+)
+
+# Only the modes and fan modes supported by LG units.
+PRESET_SCHEMA = cv.Schema(
+    {
+        # Only the standard presets; custom preset names aren't supported.
+        cv.Required(CONF_PRESET): cv.All(cv.one_of(
+            "HOME", "AWAY", "BOOST", "COMFORT", "ECO", "SLEEP", "ACTIVITY", upper=True
+        ), climate.validate_climate_preset),
+        cv.Optional(CONF_MODE): cv.All(cv.one_of(
+            "OFF", "COOL", "HEAT", "DRY", "FAN_ONLY", "HEAT_COOL", upper=True
+        ), climate.validate_climate_mode),
+        cv.Optional(CONF_TARGET_TEMPERATURE): cv.temperature,
+        cv.Optional(CONF_FAN_MODE): cv.All(cv.one_of(
+            "QUIET", "LOW", "MEDIUM", "HIGH", "AUTO", upper=True
+        ), climate.validate_climate_fan_mode),
+        cv.Optional(CONF_SWING_MODE): climate.validate_climate_swing_mode,
+        cv.Optional(CONF_VANE1): cv.int_range(min=0, max=6),
+        cv.Optional(CONF_VANE2): cv.int_range(min=0, max=6),
+        cv.Optional(CONF_VANE3): cv.int_range(min=0, max=6),
+        cv.Optional(CONF_VANE4): cv.int_range(min=0, max=6),
+        cv.Optional(CONF_OVERHEATING): cv.int_range(min=0, max=4),
+        cv.Optional(CONF_SLEEP_TIMER): cv.All(
+            cv.positive_time_period_minutes, cv.Range(max=cv.TimePeriod(minutes=420))
+        ),
+        cv.Optional(CONF_PURIFIER): cv.boolean,
+    }
+)
+
+
+def validate_presets(value):
+    presets = [conf[CONF_PRESET] for conf in value]
+    if len(presets) != len(set(presets)):
+        raise cv.Invalid("Each preset can only be used once")
+    return value
+
+
+def validate_installer_settings(value):
+    settings = [conf[CONF_SETTING] for conf in value]
+    if len(settings) != len(set(settings)):
+        raise cv.Invalid("Each installer setting can only be used once")
+    return value
+
+
+def validate_zones(value):
+    zones = [conf[CONF_ZONE] for conf in value]
+    if len(zones) != len(set(zones)):
+        raise cv.Invalid("Each zone can only be used once")
+    return value
+
+
+def aggregated_sensor_schema(**kwargs):
+    return sensor.sensor_schema(**kwargs).extend({cv.Optional(CONF_AGGREGATE): AGGREGATE_SCHEMA})
+
+
+TEMPERATURE_SENSOR_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_SENSOR): cv.use_id(sensor.Sensor),
+        cv.Optional(CONF_MAX_AGE, default="60min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_WEIGHT, default=1.0): cv.float_range(min=0, max=100),
+    }
+)
+
+ROOM_TEMP_PUSH_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_BURST, default=3): cv.int_range(min=0, max=10),
+        cv.Optional(CONF_REFILL_INTERVAL, default="10s"): cv.positive_time_period_milliseconds,
+    }
+)
+
+ROOM_TEMP_HYSTERESIS_SCHEMA = cv.Schema(
+    {
+        # How far past the midpoint between two 0.5 degree steps the temperature must be to change.
+        cv.Optional(CONF_THRESHOLD, default=0.1): cv.float_range(min=0, max=0.25),
+        # How long it must stay there.
+        cv.Optional(CONF_DWELL, default="0s"): cv.positive_time_period_milliseconds,
+    }
+)
+
+COMPENSATION_POINT_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_TEMPERATURE): cv.float_range(min=-50, max=100),
+        cv.Required(CONF_OFFSET): cv.float_range(min=-10, max=10),
+    }
+)
+
+TEMPERATURE_COMPENSATION_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_HEAT_OFFSETS, default=[]): cv.All(
+            cv.ensure_list(COMPENSATION_POINT_SCHEMA), cv.Length(max=8)
+        ),
+        cv.Optional(CONF_COOL_OFFSETS, default=[]): cv.All(
+            cv.ensure_list(COMPENSATION_POINT_SCHEMA), cv.Length(max=8)
+        ),
+        cv.Optional(CONF_KP, default=0.0): cv.float_range(min=0, max=10),
+        # Per minute.
+        cv.Optional(CONF_KI, default=0.0): cv.float_range(min=0, max=10),
+        cv.Optional(CONF_MAX_CORRECTION, default=2.0): cv.float_range(min=0, max=10),
+    }
+)
+
+PIPE_TEMP_POLL_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_ACTIVE_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_IDLE_INTERVAL, default="10min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_ACTIVE_HOLD, default="10min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_BUS_BUDGET, default="5%"): cv.All(cv.percentage, cv.Range(min=0.01, max=1.0)),
+    }
+)
+
+ENERGY_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_KILOWATT_HOURS,
+    accuracy_decimals=3,
+    device_class=DEVICE_CLASS_ENERGY,
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+).extend(
+    {
+        cv.Optional(CONF_PUBLISH_INTERVAL, default="5min"): cv.positive_time_period_milliseconds,
+        # Bounds flash writes. Energy used since the last save is lost on a reboot.
+        cv.Optional(CONF_SAVE_INTERVAL, default="60min"): cv.All(
+            cv.positive_time_period_milliseconds, cv.Range(min=cv.TimePeriod(minutes=1))
+        ),
+    }
+)
+
+DELTA_T_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_KELVIN,
+    accuracy_decimals=1,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category="diagnostic",
+)
+
+COUNT_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+    entity_category="diagnostic",
+)
+
+COIL_ANALYTICS_SCHEMA = cv.Schema(
+    {
+        # Window of the delta-T and duty cycle averages.
+        cv.Optional(CONF_WINDOW, default="60min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_DELTA_T_COOLING): DELTA_T_SCHEMA,
+        cv.Optional(CONF_DELTA_T_HEATING): DELTA_T_SCHEMA,
+        cv.Optional(CONF_DRIFT): DELTA_T_SCHEMA,
+        cv.Optional(CONF_DEFROST_COUNT): COUNT_SCHEMA,
+        cv.Optional(CONF_DEFROST_DURATION): sensor.sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category="diagnostic",
+        ),
+        cv.Optional(CONF_OUTDOOR_DUTY_CYCLE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category="diagnostic",
+        ),
+        cv.Optional(CONF_OUTDOOR_STARTS): COUNT_SCHEMA,
+    }
+)
+
+# Sensor option and CoilAnalytics setter.
+COIL_ANALYTICS_SENSORS = [
+    (CONF_DELTA_T_COOLING, "set_delta_t_cooling_sensor"),
+    (CONF_DELTA_T_HEATING, "set_delta_t_heating_sensor"),
+    (CONF_DRIFT, "set_drift_sensor"),
+    (CONF_DEFROST_COUNT, "set_defrost_count_sensor"),
+    (CONF_DEFROST_DURATION, "set_defrost_duration_sensor"),
+    (CONF_OUTDOOR_DUTY_CYCLE, "set_outdoor_duty_cycle_sensor"),
+    (CONF_OUTDOOR_STARTS, "set_outdoor_starts_sensor"),
+]
+
+def validate_passive(config):
+    if config[CONF_PASSIVE] and config[CONF_IS_SLAVE_CONTROLLER]:
+        raise cv.Invalid("passive can't be used with is_slave_controller")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
+    climate.climate_schema(LgController).extend(
+        {
+            # Optional for the host platform, where the UART is used to check if the bus is idle.
+            cv.Optional(CONF_RX_PIN): pins.gpio_input_pin_schema,
+
+            cv.Required(CONF_FAHRENHEIT): cv.boolean,
+            cv.Required(CONF_IS_SLAVE_CONTROLLER): cv.boolean,
+
+            cv.Exclusive(CONF_TEMPERATURE_SENSOR, "temperature_sensor"): cv.use_id(sensor.Sensor),
+            cv.Exclusive(CONF_TEMPERATURE_SENSORS, "temperature_sensor"): cv.All(
+                cv.ensure_list(TEMPERATURE_SENSOR_SCHEMA), cv.Length(min=1, max=8)
+            ),
+            cv.Optional(CONF_TEMPERATURE_FUSION, default="median"): cv.enum(TEMPERATURE_FUSION_OPTIONS, lower=True),
+            cv.Optional(CONF_ROOM_TEMPERATURE_STALE): binary_sensor.binary_sensor_schema(
+                device_class="problem", entity_category="diagnostic"
+            ),
+
+            # ESP32 only: handle the bus in a separate FreeRTOS task instead of the main loop.
+            cv.Optional(CONF_BUS_TASK, default=True): cv.boolean,
+            # Only listen to the unit and the other controllers, never send anything.
+            cv.Optional(CONF_PASSIVE, default=False): cv.boolean,
+
+            # With group control: address of the unit to show and change vanes and fan speeds for.
+            # Defaults to the first unit seen on the bus.
+            cv.Optional(CONF_UNIT_ADDRESS): cv.int_range(min=0, max=255),
+            cv.Optional(CONF_GROUP_UNITS): text_sensor.text_sensor_schema(
+                icon="mdi:air-conditioner", entity_category="diagnostic"
+            ),
+
+            cv.Required(CONF_VANE1): select.select_schema(LgSelect),
+            cv.Required(CONF_VANE2): select.select_schema(LgSelect),
+            cv.Required(CONF_VANE3): select.select_schema(LgSelect),
+            cv.Required(CONF_VANE4): select.select_schema(LgSelect),
+            cv.Required(CONF_OVERHEATING): select.select_schema(LgSelect),
+
+            cv.Required(CONF_FAN_SPEED_SLOW): number.number_schema(LgNumber),
+            cv.Required(CONF_FAN_SPEED_LOW): number.number_schema(LgNumber),
+            cv.Required(CONF_FAN_SPEED_MEDIUM): number.number_schema(LgNumber),
+            cv.Required(CONF_FAN_SPEED_HIGH): number.number_schema(LgNumber),
+            cv.Required(CONF_SLEEP_TIMER): number.number_schema(LgNumber),
+
+            cv.Required(CONF_ERROR_CODE): sensor.sensor_schema(),
+            cv.Optional(CONF_ERROR_HISTORY): text_sensor.text_sensor_schema(
+                icon="mdi:alert-circle-outline", entity_category="diagnostic"
+            ),
+            cv.Required(CONF_PIPE_TEMP_IN): aggregated_sensor_schema(),
+            cv.Required(CONF_PIPE_TEMP_MID): aggregated_sensor_schema(),
+            cv.Required(CONF_PIPE_TEMP_OUT): aggregated_sensor_schema(),
+
+            cv.Required(CONF_DEFROST): binary_sensor.binary_sensor_schema(),
+            cv.Required(CONF_PREHEAT): binary_sensor.binary_sensor_schema(),
+            cv.Required(CONF_OUTDOOR): binary_sensor.binary_sensor_schema(),
+            cv.Required(CONF_AUTO_DRY_ACTIVE): binary_sensor.binary_sensor_schema(),
+
+            cv.Required(CONF_PURIFIER): switch.switch_schema(LgSwitch),
+            cv.Required(CONF_INTERNAL_THERMISTOR): switch.switch_schema(LgSwitch),
+            cv.Required(CONF_AUTO_DRY): switch.switch_schema(LgSwitch),
+
+            cv.Optional(CONF_POWER): aggregated_sensor_schema(
+                unit_of_measurement=UNIT_WATT,
+                accuracy_decimals=0,
+                device_class=DEVICE_CLASS_POWER,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_ENERGY): ENERGY_SCHEMA,
+            cv.Optional(CONF_COIL_ANALYTICS): COIL_ANALYTICS_SCHEMA,
+
+            # Duct units: zone on/off switches. Changes within zone_batch_delay of each other are
+            # sent in a single status message.
+            cv.Optional(CONF_ZONES, default=[]): cv.All(
+                cv.ensure_list(ZONE_SCHEMA), cv.Length(max=8), validate_zones
+            ),
+            cv.Optional(CONF_ZONE_BATCH_DELAY, default="2s"): cv.positive_time_period_milliseconds,
+
+            # DRED (demand response) mode. Changes are sent right away, ahead of other messages.
+            cv.Optional(CONF_DRED): select.select_schema(LgSelect),
+            # DRED mode acknowledged by the unit (0 = off, 1-3 = DRM 1-3).
+            cv.Optional(CONF_DRED_STATE): sensor.sensor_schema(
+                accuracy_decimals=0,
+                entity_category="diagnostic",
+            ),
+            # Time from a DRED change to the unit's acknowledgment.
+            cv.Optional(CONF_DRED_LATENCY): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category="diagnostic",
+            ),
+
+            # Climate presets. A preset's changes are sent to the unit together.
+            cv.Optional(CONF_PRESETS, default=[]): cv.All(
+                cv.ensure_list(PRESET_SCHEMA), validate_presets
+            ),
+
+            cv.Optional(CONF_INSTALLER_SETTINGS, default=[]): cv.All(
+                cv.ensure_list(INSTALLER_SETTING_SCHEMA), validate_installer_settings
+            ),
+
+            cv.Optional(CONF_BUS_TAP): BUS_TAP_SCHEMA,
+
+            cv.Optional(CONF_TEMPERATURE_COMPENSATION): TEMPERATURE_COMPENSATION_SCHEMA,
+            cv.Optional(CONF_ROOM_TEMP_HYSTERESIS): ROOM_TEMP_HYSTERESIS_SCHEMA,
+            cv.Optional(CONF_ROOM_TEMP_PUSH, default={}): ROOM_TEMP_PUSH_SCHEMA,
+            cv.Optional(CONF_PIPE_TEMP_POLL, default={}): PIPE_TEMP_POLL_SCHEMA,
+        }
+    ).extend(cv.COMPONENT_SCHEMA).extend(uart.UART_DEVICE_SCHEMA),
+    validate_passive,
+)
+
+async def configure_aggregate(window, config):
+    if CONF_AGGREGATE not in config:
+        return
+    conf = config[CONF_AGGREGATE]
+    cg.add(window.configure(conf[CONF_WINDOW], conf[CONF_STATISTIC], conf[CONF_THRESHOLD]))
+    if CONF_MIN in conf:
+        min_sensor = await sensor.new_sensor(conf[CONF_MIN])
+        cg.add(window.set_min_sensor(min_sensor))
+    if CONF_MAX in conf:
+        max_sensor = await sensor.new_sensor(conf[CONF_MAX])
+        cg.add(window.set_max_sensor(max_sensor))
+
+
+async def to_code(config):
+    if CONF_RX_PIN in config:
+        rx_pin = await cg.gpio_pin_expression(config[CONF_RX_PIN])
     else:
-        temperature_sensor = cg.nullptr
+        rx_pin = cg.nullptr
 
     vane1 = await select.new_select(config[CONF_VANE1], options=VANE_OPTIONS)
     vane2 = await select.new_select(config[CONF_VANE2], options=VANE_OPTIONS)
@@ -121,7 +549,7 @@ async def to_code(config):
     internal_thermistor = await switch.new_switch(config[CONF_INTERNAL_THERMISTOR])
     auto_dry = await switch.new_switch(config[CONF_AUTO_DRY])
 
-    var = cg.new_Pvariable(config[CONF_ID], rx_pin, temperature_sensor,
+    var = cg.new_Pvariable(config[CONF_ID], rx_pin,
                            vane1, vane2, vane3, vane4, overheating,
                            fan_speed_slow, fan_speed_low, fan_speed_medium, fan_speed_high,
                            sleep_timer,
@@ -129,6 +557,120 @@ async def to_code(config):
                            defrost, preheat, outdoor, auto_dry_active,
                            purifier, internal_thermistor, auto_dry,
                            config[CONF_FAHRENHEIT], config[CONF_IS_SLAVE_CONTROLLER])
+
+    for conf in config[CONF_INSTALLER_SETTINGS]:
+        setting = conf[CONF_SETTING]
+        installer_number = await number.new_number(conf, min_value=0, max_value=INSTALLER_SETTINGS[setting], step=1)
+        cg.add(var.add_installer_setting(setting, installer_number))
+
+    for conf in config[CONF_ZONES]:
+        zone_switch = await switch.new_switch(conf)
+        cg.add(var.add_zone_switch(conf[CONF_ZONE], zone_switch))
+    cg.add(var.set_zone_batch_delay(config[CONF_ZONE_BATCH_DELAY]))
+
+    if CONF_DRED in config:
+        dred = await select.new_select(config[CONF_DRED], options=DRED_OPTIONS)
+        cg.add(var.set_dred_select(dred))
+    if CONF_DRED_STATE in config:
+        dred_state = await sensor.new_sensor(config[CONF_DRED_STATE])
+        cg.add(var.set_dred_state_sensor(dred_state))
+    if CONF_DRED_LATENCY in config:
+        dred_latency = await sensor.new_sensor(config[CONF_DRED_LATENCY])
+        cg.add(var.set_dred_latency_sensor(dred_latency))
+
+    for conf in config[CONF_PRESETS]:
+        preset_var = var.get_preset(conf[CONF_PRESET])
+        if CONF_MODE in conf:
+            cg.add(preset_var.set_mode(conf[CONF_MODE]))
+        if CONF_TARGET_TEMPERATURE in conf:
+            cg.add(preset_var.set_target_temperature(conf[CONF_TARGET_TEMPERATURE]))
+        if CONF_FAN_MODE in conf:
+            cg.add(preset_var.set_fan_mode(conf[CONF_FAN_MODE]))
+        if CONF_SWING_MODE in conf:
+            cg.add(preset_var.set_swing_mode(conf[CONF_SWING_MODE]))
+        for index, key in enumerate((CONF_VANE1, CONF_VANE2, CONF_VANE3, CONF_VANE4), start=1):
+            if key in conf:
+                cg.add(preset_var.set_vane(index, conf[key]))
+        if CONF_OVERHEATING in conf:
+            cg.add(preset_var.set_overheating(conf[CONF_OVERHEATING]))
+        if CONF_SLEEP_TIMER in conf:
+            cg.add(preset_var.set_sleep_timer(conf[CONF_SLEEP_TIMER].total_minutes))
+        if CONF_PURIFIER in conf:
+            cg.add(preset_var.set_purifier(conf[CONF_PURIFIER]))
+
+    if CONF_BUS_TAP in config:
+        tap = config[CONF_BUS_TAP]
+        cg.add(var.get_bus_tap().configure(str(tap[CONF_ADDRESS]), tap[CONF_PORT], tap[CONF_MAX_DELAY]))
+
+    cg.add(var.set_bus_task(config[CONF_BUS_TASK]))
+    cg.add(var.set_passive(config[CONF_PASSIVE]))
+
+    if CONF_UNIT_ADDRESS in config:
+        cg.add(var.set_unit_address(config[CONF_UNIT_ADDRESS]))
+    if CONF_GROUP_UNITS in config:
+        group_units = await text_sensor.new_text_sensor(config[CONF_GROUP_UNITS])
+        cg.add(var.set_group_units_sensor(group_units))
+
+    if CONF_ERROR_HISTORY in config:
+        error_history = await text_sensor.new_text_sensor(config[CONF_ERROR_HISTORY])
+        cg.add(var.set_error_history_sensor(error_history))
+
+    await configure_aggregate(var.get_pipe_temp_in_window(), config[CONF_PIPE_TEMP_IN])
+    await configure_aggregate(var.get_pipe_temp_mid_window(), config[CONF_PIPE_TEMP_MID])
+    await configure_aggregate(var.get_pipe_temp_out_window(), config[CONF_PIPE_TEMP_OUT])
+
+    # A single temperature_sensor is never considered stale, for compatibility.
+    if CONF_TEMPERATURE_SENSOR in config:
+        temperature_sensor = await cg.get_variable(config[CONF_TEMPERATURE_SENSOR])
+        cg.add(var.add_temperature_sensor(temperature_sensor, 0, 1000))
+    for conf in config.get(CONF_TEMPERATURE_SENSORS, []):
+        temperature_sensor = await cg.get_variable(conf[CONF_SENSOR])
+        cg.add(var.add_temperature_sensor(temperature_sensor, conf[CONF_MAX_AGE],
+                                          int(round(conf[CONF_WEIGHT] * 1000))))
+    cg.add(var.set_temperature_fusion(config[CONF_TEMPERATURE_FUSION]))
+    if CONF_ROOM_TEMPERATURE_STALE in config:
+        stale = await binary_sensor.new_binary_sensor(config[CONF_ROOM_TEMPERATURE_STALE])
+        cg.add(var.set_room_temp_stale_sensor(stale))
+
+    if CONF_POWER in config:
+        power = await sensor.new_sensor(config[CONF_POWER])
+        cg.add(var.set_power_sensor(power))
+        await configure_aggregate(var.get_power_window(), config[CONF_POWER])
+    if CONF_ENERGY in config:
+        energy = await sensor.new_sensor(config[CONF_ENERGY])
+        cg.add(var.set_energy_sensor(energy, config[CONF_ENERGY][CONF_PUBLISH_INTERVAL],
+                                     config[CONF_ENERGY][CONF_SAVE_INTERVAL]))
+
+    if CONF_COIL_ANALYTICS in config:
+        coil = config[CONF_COIL_ANALYTICS]
+        coil_var = var.get_coil_analytics()
+        cg.add(coil_var.configure(coil[CONF_WINDOW]))
+        for key, setter in COIL_ANALYTICS_SENSORS:
+            if key in coil:
+                sens = await sensor.new_sensor(coil[key])
+                cg.add(getattr(coil_var, setter)(sens))
+
+    if CONF_TEMPERATURE_COMPENSATION in config:
+        comp = config[CONF_TEMPERATURE_COMPENSATION]
+        comp_var = var.get_temp_compensation()
+        cg.add(comp_var.set_pi(int(round(comp[CONF_KP] * 1000)), int(round(comp[CONF_KI] * 1000)),
+                               int(round(comp[CONF_MAX_CORRECTION] * 100))))
+        for heat, key in ((True, CONF_HEAT_OFFSETS), (False, CONF_COOL_OFFSETS)):
+            for point in sorted(comp[key], key=lambda p: p[CONF_TEMPERATURE]):
+                cg.add(comp_var.add_curve_point(heat, int(round(point[CONF_TEMPERATURE] * 100)),
+                                                int(round(point[CONF_OFFSET] * 100))))
+
+    if CONF_ROOM_TEMP_HYSTERESIS in config:
+        hysteresis = config[CONF_ROOM_TEMP_HYSTERESIS]
+        cg.add(var.set_room_temp_hysteresis(hysteresis[CONF_THRESHOLD], hysteresis[CONF_DWELL]))
+
+    push = config[CONF_ROOM_TEMP_PUSH]
+    cg.add(var.set_room_temp_push(push[CONF_BURST], push[CONF_REFILL_INTERVAL]))
+
+    poll = config[CONF_PIPE_TEMP_POLL]
+    cg.add(var.set_pipe_temp_poll(poll[CONF_ACTIVE_INTERVAL], poll[CONF_IDLE_INTERVAL],
+                                  poll[CONF_ACTIVE_HOLD], int(round(poll[CONF_BUS_BUDGET] * 100))))
+
     await climate.register_climate(var, config)
     await cg.register_component(var, config)
     await uart.register_uart_device(var, config)
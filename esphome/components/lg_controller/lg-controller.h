@@ -3,6 +3,14 @@
 #include "esphome.h"
 #include "esphome/components/uart/uart.h"
 
+#include "lg-protocol.h"
+#include "bus-engine.h"
+#include "bus-tap.h"
+
+#ifdef USE_ESP32
+#include <esp_attr.h>
+#endif
+
 static const char* const TAG = "lg-controller";
 
 namespace esphome::lg_controller {
@@ -128,13 +136,787 @@ public:
 constexpr int8_t TempConversion::FahToLGCel[];
 constexpr int8_t TempConversion::LGCelToCelAdjustment[];
 
+// Compensation applied to the external room temperature before it's sent to the unit. This can
+// be used to bias the unit's thermostat without a Home Assistant template sensor:
+//
+// * An offset per operation mode (heating or cooling/dehumidify), interpolated linearly between
+//   configured points based on the measured room temperature.
+// * A PI-style correction that lowers the reported temperature while the room stays below the
+//   setpoint (and raises it while it stays above). Only used in heating and cooling mode.
+//
+// The correction is clamped to +/- max_correction. All math is done in integers, with
+// temperatures stored in hundredths of a degree and gains in thousandths.
+class TempCompensation {
+public:
+    struct CurvePoint {
+        int16_t temp_centi;
+        int16_t offset_centi;
+    };
+    static constexpr size_t MaxCurvePoints = 8;
+
+private:
+    CurvePoint heat_curve_[MaxCurvePoints] = {};
+    uint8_t heat_curve_len_ = 0;
+    CurvePoint cool_curve_[MaxCurvePoints] = {};
+    uint8_t cool_curve_len_ = 0;
+
+    int32_t kp_milli_ = 0;
+    // Integral gain per minute.
+    int32_t ki_milli_ = 0;
+    int32_t max_correction_centi_ = 0;
+
+    // Integral of the error in centi-degrees * seconds.
+    int32_t integral_ = 0;
+    uint32_t last_step_millis_ = 0;
+    bool stepped_ = false;
+    climate::ClimateMode last_mode_ = climate::CLIMATE_MODE_OFF;
+
+    static int32_t interpolate(const CurvePoint* curve, size_t len, int32_t temp_centi) {
+        if (len == 0) {
+            return 0;
+        }
+        if (temp_centi <= curve[0].temp_centi) {
+            return curve[0].offset_centi;
+        }
+        for (size_t i = 1; i < len; i++) {
+            const CurvePoint& a = curve[i - 1];
+            const CurvePoint& b = curve[i];
+            if (temp_centi <= b.temp_centi) {
+                int32_t span = b.temp_centi - a.temp_centi;
+                if (span <= 0) {
+                    return b.offset_centi;
+                }
+                return a.offset_centi + (b.offset_centi - a.offset_centi) * (temp_centi - a.temp_centi) / span;
+            }
+        }
+        return curve[len - 1].offset_centi;
+    }
+
+    static bool uses_pi(climate::ClimateMode mode) {
+        return mode == climate::CLIMATE_MODE_HEAT || mode == climate::CLIMATE_MODE_COOL;
+    }
+
+    int32_t integral_limit() const {
+        // Limit the integral so the I term alone can't exceed max_correction (anti-windup).
+        if (ki_milli_ == 0) {
+            return 0;
+        }
+        return int32_t(int64_t(max_correction_centi_) * 1000 * 60 / ki_milli_);
+    }
+
+public:
+    bool enabled() const {
+        return heat_curve_len_ > 0 || cool_curve_len_ > 0 || kp_milli_ != 0 || ki_milli_ != 0;
+    }
+
+    void set_pi(int32_t kp_milli, int32_t ki_milli, int32_t max_correction_centi) {
+        kp_milli_ = kp_milli;
+        ki_milli_ = std::max<int32_t>(ki_milli, 0);
+        max_correction_centi_ = std::max<int32_t>(max_correction_centi, 0);
+    }
+
+    // Points must be added in order of increasing temperature.
+    void add_curve_point(bool heat, int16_t temp_centi, int16_t offset_centi) {
+        CurvePoint* curve = heat ? heat_curve_ : cool_curve_;
+        uint8_t& len = heat ? heat_curve_len_ : cool_curve_len_;
+        if (len >= MaxCurvePoints) {
+            ESP_LOGE(TAG, "Too many temperature compensation points");
+            return;
+        }
+        curve[len++] = {temp_centi, offset_centi};
+    }
+
+    // Updates the integral. Called once for each message sent to the unit.
+    void step(climate::ClimateMode mode, int32_t measured_centi, int32_t setpoint_centi, uint32_t now) {
+        if (mode != last_mode_ || !uses_pi(mode)) {
+            integral_ = 0;
+        } else if (stepped_) {
+            // Don't let a long gap (unit off, bus errors) cause a big jump.
+            uint32_t dt_secs = std::min<uint32_t>((now - last_step_millis_) / 1000, 5 * 60);
+            int32_t limit = integral_limit();
+            int32_t integral = integral_ + (setpoint_centi - measured_centi) * int32_t(dt_secs);
+            integral_ = std::max(-limit, std::min(limit, integral));
+        }
+        last_mode_ = mode;
+        last_step_millis_ = now;
+        stepped_ = true;
+    }
+
+    // Returns the value to add to the measured temperature, in centi-degrees.
+    int32_t correction(climate::ClimateMode mode, int32_t measured_centi, int32_t setpoint_centi) const {
+        int32_t offset = 0;
+        if (mode == climate::CLIMATE_MODE_HEAT) {
+            offset = interpolate(heat_curve_, heat_curve_len_, measured_centi);
+        } else if (mode == climate::CLIMATE_MODE_COOL || mode == climate::CLIMATE_MODE_DRY) {
+            offset = interpolate(cool_curve_, cool_curve_len_, measured_centi);
+        }
+        int32_t pi = 0;
+        if (uses_pi(mode) && mode == last_mode_) {
+            int32_t error = setpoint_centi - measured_centi;
+            pi = int32_t((int64_t(kp_milli_) * error + int64_t(ki_milli_) * integral_ / 60) / 1000);
+        }
+        // A room that's too cold (positive error) is reported as colder so the unit heats more.
+        int32_t result = offset - pi;
+        return std::max(-max_correction_centi_, std::min(max_correction_centi_, result));
+    }
+};
+
+// Quantizes room temperatures to 0.5 degree steps, clamped to 11-35. A sensor hovering around the
+// midpoint between two steps would make plain rounding flip between them, so the output only changes
+// if the input is at least `hysteresis` past the midpoint and, with a dwell time, if it stays there
+// for that long. Without hysteresis and dwell time, this is the same as rounding.
+class TempQuantizer {
+    float hysteresis_ = 0;
+    uint32_t dwell_millis_ = 0;
+    optional<float> output_{};
+    optional<uint32_t> change_since_millis_{};
+
+public:
+    void configure(float hysteresis, uint32_t dwell_millis) {
+        hysteresis_ = hysteresis;
+        dwell_millis_ = dwell_millis;
+    }
+
+    float quantize(float temp, uint32_t now) {
+        temp = std::min(std::max(temp, 11.0f), 35.0f);
+        float nearest = round(temp * 2) / 2;
+        if (!output_.has_value()) {
+            output_ = nearest;
+            return nearest;
+        }
+        if (nearest == *output_ || std::abs(temp - *output_) < 0.25f + hysteresis_) {
+            change_since_millis_.reset();
+            return *output_;
+        }
+        if (dwell_millis_ > 0) {
+            if (!change_since_millis_.has_value()) {
+                change_since_millis_ = now;
+            }
+            if (now - *change_since_millis_ < dwell_millis_) {
+                return *output_;
+            }
+        }
+        change_since_millis_.reset();
+        output_ = nearest;
+        return nearest;
+    }
+};
+
+// Token bucket rate limiter. Holds up to `capacity` tokens and adds a token every
+// `refill_millis` milliseconds. A capacity of 0 disables it (nothing is ever allowed).
+class TokenBucket {
+    uint32_t capacity_;
+    uint32_t refill_millis_;
+    uint32_t tokens_;
+    uint32_t last_refill_millis_ = 0;
+
+public:
+    TokenBucket(uint32_t capacity, uint32_t refill_millis)
+      : capacity_(capacity), refill_millis_(refill_millis), tokens_(capacity)
+    {}
+
+    void configure(uint32_t capacity, uint32_t refill_millis) {
+        capacity_ = capacity;
+        refill_millis_ = std::max<uint32_t>(refill_millis, 1);
+        tokens_ = capacity;
+    }
+
+    bool has_token(uint32_t now) {
+        if (tokens_ < capacity_) {
+            uint32_t refills = (now - last_refill_millis_) / refill_millis_;
+            if (refills > 0) {
+                tokens_ = std::min(capacity_, tokens_ + refills);
+                last_refill_millis_ += refills * refill_millis_;
+            }
+        }
+        return tokens_ > 0;
+    }
+
+    void consume(uint32_t now) {
+        if (tokens_ == capacity_) {
+            // Start refilling from now, not from when the bucket became full.
+            last_refill_millis_ = now;
+        }
+        if (tokens_ > 0) {
+            tokens_--;
+        }
+    }
+};
+
+// Integrates the power usage reported by the unit into energy. Energy is stored in watt-milliseconds
+// so integer math doesn't lose anything between samples; a uint64_t holds billions of kWh.
+//
+// The last power value is held until the next sample. If there's no new sample for a long time,
+// the unit likely stopped sending them and we stop integrating until the next one.
+class EnergyMeter {
+    static constexpr uint32_t MaxSampleGapMillis = 10 * 60 * 1000;
+    static constexpr uint64_t WattMillisPerKWh = 1000ULL * 3600 * 1000;
+
+    uint64_t energy_watt_millis_ = 0;
+    uint32_t power_watts_ = 0;
+    uint32_t last_millis_ = 0;
+    bool have_power_ = false;
+
+public:
+    void restore(uint64_t energy_watt_millis) {
+        energy_watt_millis_ = energy_watt_millis;
+    }
+
+    uint64_t energy_watt_millis() const {
+        return energy_watt_millis_;
+    }
+
+    float energy_kwh() const {
+        return double(energy_watt_millis_) / WattMillisPerKWh;
+    }
+
+    void add_sample(uint32_t watts, uint32_t now) {
+        advance(now);
+        power_watts_ = watts;
+        last_millis_ = now;
+        have_power_ = true;
+    }
+
+    // Add energy used since the previous sample or advance call.
+    void advance(uint32_t now) {
+        if (!have_power_) {
+            return;
+        }
+        uint32_t elapsed = now - last_millis_;
+        if (elapsed > MaxSampleGapMillis) {
+            elapsed = MaxSampleGapMillis;
+            have_power_ = false;
+        }
+        energy_watt_millis_ += uint64_t(power_watts_) * elapsed;
+        last_millis_ = now;
+    }
+};
+
+// Aggregates sensor samples over a time window and publishes one summary value (mean, min, max or
+// last) when the window ends. A sample that differs from the last published value by at least the
+// threshold is published right away (with the window so far), so large changes aren't delayed.
+// Optional min/max sensors receive the window's extremes. Without a window, every sample is
+// published directly.
+class SensorWindow {
+public:
+    enum class Statistic : uint8_t { Mean, Min, Max, Last };
+
+private:
+    sensor::Sensor* sensor_ = nullptr;
+    sensor::Sensor* min_sensor_ = nullptr;
+    sensor::Sensor* max_sensor_ = nullptr;
+    uint32_t window_millis_ = 0;
+    Statistic statistic_ = Statistic::Mean;
+    float threshold_ = 0; // 0: disabled
+
+    uint32_t window_start_millis_ = 0;
+    uint32_t count_ = 0;
+    float sum_ = 0;
+    float min_ = 0;
+    float max_ = 0;
+    float last_ = 0;
+    bool published_ = false;
+    float last_published_ = 0;
+
+public:
+    void set_sensor(sensor::Sensor* sensor) {
+        sensor_ = sensor;
+    }
+    bool has_sensor() const {
+        return sensor_ != nullptr;
+    }
+    bool is_windowed() const {
+        return window_millis_ > 0;
+    }
+
+    // Statistic: 0 = mean, 1 = min, 2 = max, 3 = last.
+    void configure(uint32_t window_millis, uint8_t statistic, float threshold) {
+        window_millis_ = window_millis;
+        statistic_ = Statistic(statistic);
+        threshold_ = threshold;
+    }
+    void set_min_sensor(sensor::Sensor* sensor) {
+        min_sensor_ = sensor;
+    }
+    void set_max_sensor(sensor::Sensor* sensor) {
+        max_sensor_ = sensor;
+    }
+
+    void add(float value, uint32_t now) {
+        if (sensor_ == nullptr) {
+            return;
+        }
+        if (window_millis_ == 0) {
+            sensor_->publish_state(value);
+            return;
+        }
+        if (count_ == 0) {
+            window_start_millis_ = now;
+            sum_ = 0;
+            min_ = value;
+            max_ = value;
+        }
+        count_++;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        last_ = value;
+
+        // Publish the first sample immediately so there's a value after booting.
+        if (!published_ || (threshold_ > 0 && std::abs(value - last_published_) >= threshold_)) {
+            flush();
+        }
+    }
+
+    // Publish the summary if the current window has ended.
+    void loop(uint32_t now) {
+        if (count_ > 0 && now - window_start_millis_ >= window_millis_) {
+            flush();
+        }
+    }
+
+private:
+    void flush() {
+        float value = last_;
+        switch (statistic_) {
+            case Statistic::Mean:
+                value = sum_ / count_;
+                break;
+            case Statistic::Min:
+                value = min_;
+                break;
+            case Statistic::Max:
+                value = max_;
+                break;
+            case Statistic::Last:
+                break;
+        }
+        sensor_->publish_state(value);
+        if (min_sensor_ != nullptr) {
+            min_sensor_->publish_state(min_);
+        }
+        if (max_sensor_ != nullptr) {
+            max_sensor_->publish_state(max_);
+        }
+        published_ = true;
+        last_published_ = value;
+        count_ = 0;
+    }
+};
+
+// Exponentially weighted moving average over a time window. Each sample's weight depends on how
+// long it represents, so irregular sample intervals don't skew the average. O(1) time and memory.
+class TimeEwma {
+    float value_ = 0;
+    bool valid_ = false;
+
+public:
+    bool valid() const {
+        return valid_;
+    }
+    float value() const {
+        return value_;
+    }
+
+    void restore(float value) {
+        value_ = value;
+        valid_ = true;
+    }
+
+    void add(float sample, uint32_t sample_millis, uint32_t window_millis) {
+        if (!valid_) {
+            value_ = sample;
+            valid_ = true;
+            return;
+        }
+        float alpha = 1.0f - expf(-float(sample_millis) / float(std::max<uint32_t>(window_millis, 1)));
+        value_ += alpha * (sample - value_);
+    }
+};
+
+// Streaming statistics for the indoor coil and outdoor unit, computed from the pipe temperatures
+// and the outdoor/defrost/preheat bits:
+//
+// - Coil delta-T (in/out pipe difference) per mode, only sampled in steady state: the outdoor
+//   unit has been running for a while and there's no defrost or preheat.
+// - A baseline of the delta-T per mode, and the drift of the short-term average from it. The
+//   baseline is the average over the first BaselineLearnSeconds of steady-state samples and is
+//   then frozen, so a slowly degrading coil can't pull it along. It's saved to flash so it
+//   survives reboots. A growing drift can indicate low refrigerant or a dirty coil or filter.
+// - Defrost count and average duration.
+// - Outdoor unit duty cycle and start count.
+//
+// Counts are since boot (total_increasing sensors handle resets).
+class CoilAnalytics {
+public:
+    enum class Mode : uint8_t { Cooling, Heating };
+
+    struct Baseline {
+        float delta_t;
+        uint32_t learned_seconds;
+    };
+
+private:
+    static constexpr size_t NumModes = 2;
+
+    // Samples are usually one pipe temperature poll interval apart. Larger gaps (the unit was
+    // off or stopped responding) count as this much.
+    static constexpr uint32_t MaxSampleGapMillis = 10 * 60 * 1000;
+    // The outdoor unit must have been running this long (and this long after a defrost) before
+    // pipe temperatures are used.
+    static constexpr uint32_t SteadyStateMillis = 10 * 60 * 1000;
+    // Outdoor unit starts after a shorter off period are counted as the same run. The unit
+    // sometimes reports ON => OFF => ON within a few seconds.
+    static constexpr uint32_t MinOffMillis = 60 * 1000;
+    // Steady-state sample time averaged into the baseline before it's frozen.
+    static constexpr uint32_t BaselineLearnSeconds = 24 * 60 * 60;
+    // Defrost durations are averaged over roughly the last four defrosts.
+    static constexpr float DefrostAlpha = 0.25f;
+
+    sensor::Sensor* delta_t_sensors_[NumModes] = {};
+    sensor::Sensor* drift_sensor_ = nullptr;
+    sensor::Sensor* defrost_count_sensor_ = nullptr;
+    sensor::Sensor* defrost_duration_sensor_ = nullptr;
+    sensor::Sensor* duty_cycle_sensor_ = nullptr;
+    sensor::Sensor* starts_sensor_ = nullptr;
+
+    uint32_t window_millis_ = 60 * 60 * 1000;
+
+    TimeEwma delta_t_[NumModes];
+    float baseline_[NumModes] = {};
+    uint32_t baseline_millis_[NumModes] = {}; // Sample time toward BaselineLearnSeconds, below 1 s.
+    uint32_t baseline_seconds_[NumModes] = {};
+    uint32_t last_sample_millis_[NumModes] = {};
+    bool have_sample_[NumModes] = {};
+    optional<Mode> last_mode_{};
+
+    bool have_activity_ = false;
+    bool outdoor_on_ = false;
+    bool defrost_ = false;
+    bool preheat_ = false;
+    uint32_t outdoor_on_since_millis_ = 0;
+    uint32_t outdoor_off_since_millis_ = 0;
+    optional<uint32_t> defrost_since_millis_{};
+    uint32_t defrost_end_millis_ = 0;
+    bool had_defrost_ = false;
+
+    TimeEwma duty_cycle_;
+    uint32_t duty_cycle_millis_ = 0;
+    optional<float> defrost_seconds_{};
+    uint32_t defrost_count_ = 0;
+    uint32_t outdoor_starts_ = 0;
+
+    // Integrate the outdoor unit state since the previous call.
+    void advance_duty_cycle(uint32_t now) {
+        if (!have_activity_) {
+            return;
+        }
+        uint32_t elapsed = std::min(now - duty_cycle_millis_, MaxSampleGapMillis);
+        if (elapsed > 0) {
+            duty_cycle_.add(outdoor_on_ ? 100.0f : 0.0f, elapsed, window_millis_);
+        }
+        duty_cycle_millis_ = now;
+    }
+
+    static void publish(sensor::Sensor* sensor, float value) {
+        if (sensor != nullptr) {
+            sensor->publish_state(value);
+        }
+    }
+
+public:
+    void configure(uint32_t window_millis) {
+        window_millis_ = window_millis;
+    }
+
+    void set_delta_t_cooling_sensor(sensor::Sensor* sensor) {
+        delta_t_sensors_[size_t(Mode::Cooling)] = sensor;
+    }
+    void set_delta_t_heating_sensor(sensor::Sensor* sensor) {
+        delta_t_sensors_[size_t(Mode::Heating)] = sensor;
+    }
+    void set_drift_sensor(sensor::Sensor* sensor) {
+        drift_sensor_ = sensor;
+    }
+    void set_defrost_count_sensor(sensor::Sensor* sensor) {
+        defrost_count_sensor_ = sensor;
+    }
+    void set_defrost_duration_sensor(sensor::Sensor* sensor) {
+        defrost_duration_sensor_ = sensor;
+    }
+    void set_outdoor_duty_cycle_sensor(sensor::Sensor* sensor) {
+        duty_cycle_sensor_ = sensor;
+    }
+    void set_outdoor_starts_sensor(sensor::Sensor* sensor) {
+        starts_sensor_ = sensor;
+    }
+
+    bool enabled() const {
+        return delta_t_sensors_[0] != nullptr || delta_t_sensors_[1] != nullptr ||
+               drift_sensor_ != nullptr || defrost_count_sensor_ != nullptr ||
+               defrost_duration_sensor_ != nullptr || duty_cycle_sensor_ != nullptr ||
+               starts_sensor_ != nullptr;
+    }
+
+    void restore_baseline(Mode mode, const Baseline& baseline) {
+        if (baseline.learned_seconds > 0) {
+            baseline_[size_t(mode)] = baseline.delta_t;
+            baseline_seconds_[size_t(mode)] = baseline.learned_seconds;
+        }
+    }
+    Baseline get_baseline(Mode mode) const {
+        return {baseline_[size_t(mode)], baseline_seconds_[size_t(mode)]};
+    }
+
+    // Called for every status message from the unit.
+    void update_activity(bool outdoor_on, bool defrost, bool preheat, uint32_t now) {
+        advance_duty_cycle(now);
+
+        if (!have_activity_) {
+            // We don't know when the current run or defrost started, so don't count it.
+            have_activity_ = true;
+            outdoor_on_ = outdoor_on;
+            defrost_ = defrost;
+            preheat_ = preheat;
+            outdoor_on_since_millis_ = now;
+            outdoor_off_since_millis_ = now;
+            duty_cycle_millis_ = now;
+            publish(defrost_count_sensor_, 0);
+            publish(starts_sensor_, 0);
+            return;
+        }
+
+        if (outdoor_on && !outdoor_on_) {
+            if (now - outdoor_off_since_millis_ >= MinOffMillis) {
+                outdoor_on_since_millis_ = now;
+                outdoor_starts_++;
+                publish(starts_sensor_, outdoor_starts_);
+            }
+        } else if (!outdoor_on && outdoor_on_) {
+            outdoor_off_since_millis_ = now;
+        }
+        outdoor_on_ = outdoor_on;
+
+        if (defrost && !defrost_) {
+            defrost_since_millis_ = now;
+        } else if (!defrost && defrost_) {
+            had_defrost_ = true;
+            defrost_end_millis_ = now;
+            if (defrost_since_millis_.has_value()) {
+                float seconds = (now - *defrost_since_millis_) / 1000.0f;
+                if (defrost_seconds_.has_value()) {
+                    seconds = *defrost_seconds_ + DefrostAlpha * (seconds - *defrost_seconds_);
+                }
+                defrost_seconds_ = seconds;
+                defrost_count_++;
+                publish(defrost_count_sensor_, defrost_count_);
+                publish(defrost_duration_sensor_, seconds);
+                defrost_since_millis_.reset();
+            }
+        }
+        defrost_ = defrost;
+        preheat_ = preheat;
+    }
+
+    // Called for every pipe temperature sample (in degrees Celsius) from the unit.
+    void add_pipe_temps(float in, float out, Mode mode, uint32_t now) {
+        if (!have_activity_ || !outdoor_on_ || defrost_ || preheat_ ||
+            now - outdoor_on_since_millis_ < SteadyStateMillis ||
+            (had_defrost_ && now - defrost_end_millis_ < SteadyStateMillis)) {
+            return;
+        }
+
+        size_t m = size_t(mode);
+        // Positive when the coil is doing its job: cooling the air in cooling mode, heating it
+        // in heating mode.
+        float delta_t = mode == Mode::Cooling ? out - in : in - out;
+        uint32_t sample_millis = have_sample_[m]
+                                     ? std::min(now - last_sample_millis_[m], MaxSampleGapMillis)
+                                     : MaxSampleGapMillis;
+        have_sample_[m] = true;
+        last_sample_millis_[m] = now;
+        last_mode_ = mode;
+
+        delta_t_[m].add(delta_t, sample_millis, window_millis_);
+        if (baseline_seconds_[m] < BaselineLearnSeconds) {
+            // Time-weighted mean of all samples so far.
+            uint64_t learned_millis = uint64_t(baseline_seconds_[m]) * 1000 + baseline_millis_[m] + sample_millis;
+            baseline_[m] += (delta_t - baseline_[m]) * float(sample_millis) / float(learned_millis);
+            baseline_millis_[m] += sample_millis;
+            baseline_seconds_[m] += baseline_millis_[m] / 1000;
+            baseline_millis_[m] %= 1000;
+        }
+    }
+
+    // Publishes the averages. Called at a low rate.
+    void publish_averages(uint32_t now) {
+        advance_duty_cycle(now);
+        if (duty_cycle_.valid()) {
+            publish(duty_cycle_sensor_, duty_cycle_.value());
+        }
+        for (size_t m = 0; m < NumModes; m++) {
+            if (delta_t_[m].valid()) {
+                publish(delta_t_sensors_[m], delta_t_[m].value());
+            }
+        }
+        if (last_mode_.has_value()) {
+            size_t m = size_t(*last_mode_);
+            if (baseline_seconds_[m] >= BaselineLearnSeconds && delta_t_[m].valid()) {
+                publish(drift_sensor_, delta_t_[m].value() - baseline_[m]);
+            }
+        }
+    }
+};
+
+// Settings applied by a climate preset. Unset fields aren't changed.
+struct PresetSettings {
+    climate::ClimatePreset preset;
+    optional<climate::ClimateMode> mode{};
+    optional<float> target_temperature{};
+    optional<climate::ClimateFanMode> fan_mode{};
+    optional<climate::ClimateSwingMode> swing_mode{};
+    optional<uint8_t> vanes[4] = {};
+    optional<uint8_t> overheating{};
+    optional<uint16_t> sleep_timer_minutes{};
+    optional<bool> purifier{};
+
+    void set_mode(climate::ClimateMode value) {
+        mode = value;
+    }
+    void set_target_temperature(float value) {
+        target_temperature = value;
+    }
+    void set_fan_mode(climate::ClimateFanMode value) {
+        fan_mode = value;
+    }
+    void set_swing_mode(climate::ClimateSwingMode value) {
+        swing_mode = value;
+    }
+    // Index: 1-4.
+    void set_vane(uint8_t index, uint8_t position) {
+        if (index >= 1 && index <= 4) {
+            vanes[index - 1] = position;
+        }
+    }
+    void set_overheating(uint8_t value) {
+        overheating = value;
+    }
+    void set_sleep_timer(uint16_t minutes) {
+        sleep_timer_minutes = minutes;
+    }
+    void set_purifier(bool value) {
+        purifier = value;
+    }
+};
+
+// Ring of error code changes, shared by all controllers. On ESP32 this is stored in RTC memory,
+// which isn't cleared by soft resets (including watchdog resets), so the history survives those
+// without writing to flash. After a power loss, the magic value won't match and it's cleared.
+struct ErrorHistory {
+    static constexpr uint32_t Magic = 0x4C474548;
+    static constexpr uint32_t Size = 16;
+
+    struct Entry {
+        uint32_t controller;     // Object ID hash of the controller
+        uint32_t boot;
+        uint32_t uptime_seconds;
+        uint8_t code;
+    };
+
+    uint32_t magic;
+    uint32_t boot;
+    uint32_t next;
+    uint32_t count;
+    Entry entries[Size];
+
+    void init() {
+        if (magic != Magic || next >= Size || count > Size) {
+            std::memset(this, 0, sizeof(*this));
+            magic = Magic;
+        } else {
+            boot++;
+        }
+    }
+
+    void add(uint32_t controller, uint8_t code, uint32_t uptime_seconds) {
+        entries[next] = {controller, boot, uptime_seconds, code};
+        next = (next + 1) % Size;
+        count = std::min(count + 1, Size);
+    }
+
+    // Returns the i-th most recent entry.
+    const Entry& get(uint32_t i) const {
+        return entries[(next + Size - 1 - i) % Size];
+    }
+};
+
+#ifdef USE_ESP32
+static RTC_NOINIT_ATTR ErrorHistory error_history_storage;
+#else
+static ErrorHistory error_history_storage;
+#endif
+
+inline ErrorHistory& get_error_history() {
+    static bool initialized = false;
+    if (!initialized) {
+        error_history_storage.init();
+        initialized = true;
+    }
+    return error_history_storage;
+}
+
+// BusIo for the UART and RX pin.
+class UartBusIo final : public BusIo {
+    uart::UARTDevice* uart_ = nullptr;
+    InternalGPIOPin* rx_pin_ = nullptr;
+
+public:
+    void init(uart::UARTDevice* uart, InternalGPIOPin* rx_pin) {
+        uart_ = uart;
+        rx_pin_ = rx_pin;
+    }
+    int available() override {
+        return uart_->available();
+    }
+    bool read_byte(uint8_t* data) override {
+        return uart_->read_byte(data);
+    }
+    void write_array(const uint8_t* data, size_t len) override {
+        uart_->write_array(data, len);
+    }
+    // Using digital_read is *much* better for detecting activity than using the UART because that
+    // has to wait for a full byte to arrive and this takes about 9-10 ms with our slow baud rate.
+    // There are also various buffers and timeouts before incoming bytes reach us. Without an RX
+    // pin (host platform), only the UART is checked.
+    bool line_active() override {
+        return rx_pin_ != nullptr && !rx_pin_->digital_read();
+    }
+};
+
 class LgController final : public climate::Climate, public uart::UARTDevice, public Component {
-    static constexpr size_t MsgLen = 13;
+    // Time it takes to send a single message at 104 bps (13 bytes, 10 bits per byte).
+    static constexpr uint32_t MsgWireMillis = MsgLen * 10 * 1000 / 104;
 
     climate::ClimateTraits supported_traits_{};
 
-    InternalGPIOPin& rx_pin_;
-    esphome::sensor::Sensor* temperature_sensor_;
+    // RX pin used to check if the bus is idle. Optional, for example on the host platform where
+    // the UART is a pty or USB serial device. Then only the UART is used for this.
+    InternalGPIOPin* rx_pin_;
+
+    // External room temperature sensors. Values from sensors that haven't been updated within
+    // their max age are ignored. If all sensors are stale, we fall back to the unit's thermistor.
+    struct RoomTempInput {
+        esphome::sensor::Sensor* sensor;
+        uint32_t max_age_millis; // 0: never stale
+        uint32_t weight_milli;
+        uint32_t last_update_millis;
+    };
+    static constexpr size_t MaxRoomTempInputs = 8;
+    std::vector<RoomTempInput> room_temp_inputs_;
+    enum class TempFusion : uint8_t { Median, Mean, WeightedMean, Min, Max };
+    TempFusion temp_fusion_ = TempFusion::Median;
+    esphome::binary_sensor::BinarySensor* room_temp_stale_sensor_ = nullptr;
+    bool room_temp_stale_ = false;
 
     LgSelect& vane_select_1_;
     LgSelect& vane_select_2_;
@@ -150,9 +932,14 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
     LgNumber& sleep_timer_;
 
     esphome::sensor::Sensor& error_code_;
+    esphome::text_sensor::TextSensor* error_history_sensor_ = nullptr;
+    optional<uint8_t> last_error_code_{};
     esphome::sensor::Sensor& pipe_temp_in_;
     esphome::sensor::Sensor& pipe_temp_mid_;
     esphome::sensor::Sensor& pipe_temp_out_;
+    SensorWindow pipe_temp_in_window_;
+    SensorWindow pipe_temp_mid_window_;
+    SensorWindow pipe_temp_out_window_;
     esphome::binary_sensor::BinarySensor& defrost_;
     esphome::binary_sensor::BinarySensor& preheat_;
     esphome::binary_sensor::BinarySensor& outdoor_;
@@ -163,29 +950,166 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
     LgSwitch& internal_thermistor_;
     LgSwitch& auto_dry_;
 
-    uint8_t recv_buf_[MsgLen] = {};
-    uint32_t recv_buf_len_ = 0;
-    uint32_t last_recv_millis_ = 0;
+    // Receives and sends messages. Runs in its own task on ESP32 if `bus_task_` is set, else it's
+    // polled from loop().
+    UartBusIo bus_io_;
+    BusEngine bus_;
+    bool bus_task_ = true;
+    bool bus_task_running_ = false;
+    // Set when a received message was invalid since the last update(). Status messages are then
+    // ignored and update() doesn't send anything.
+    bool had_error_ = false;
+    // Passive mode: only listen to the unit and the other controllers, never send anything.
+    bool passive_ = false;
 
     // Last received 0xC8 message.
     uint8_t last_recv_status_[MsgLen] = {};
 
-    // Last received 0xCA message.
+    // Last received 0xCA message from the unit we control settings for (see units_).
     uint8_t last_recv_type_a_settings_[MsgLen] = {};
 
+    // Indoor units on the bus, by the address in their CA messages. With group control, several
+    // units are connected to one bus. Status messages don't have an address so all units share
+    // the same operation mode, setpoint etc., but settings messages are per unit. Vanes and fan
+    // speeds are shown for one unit: the configured address or else the first unit we see.
+    struct UnitState {
+        uint8_t address;
+        uint32_t last_seen_millis;
+        uint8_t type_a_settings[MsgLen];
+    };
+    static constexpr size_t MaxUnits = 16;
+    static constexpr uint8_t NoUnitSlot = 0xFF;
+    uint8_t unit_slots_[256];   // Address => index in units_, for O(1) lookups
+    std::vector<UnitState> units_;
+    optional<uint8_t> unit_address_{};
+    bool group_control_ = false;
+    esphome::text_sensor::TextSensor* group_units_sensor_ = nullptr;
+
     // Last received 0xCB message.
     uint8_t last_recv_type_b_settings_[MsgLen] = {};
 
     uint8_t send_buf_[MsgLen] = {};
-    uint32_t last_sent_status_millis_ = 0;
     uint32_t last_sent_recv_type_b_millis_ = 0;
 
-    enum class PendingSendKind : uint8_t { None, Status, TypeA, TypeB };
-    PendingSendKind pending_send_ = PendingSendKind::None;
-
-    bool pending_status_change_ = false;
-    bool pending_type_a_settings_change_ = false;
-    bool pending_type_b_settings_change_ = false;
+    // Pipe temperatures are requested with a timed AB message. This is done more frequently
+    // while the outdoor unit, defrost or preheat is active (or was changed recently) and less
+    // frequently when the unit is idle.
+    uint32_t pipe_temp_poll_active_interval_ = 60 * 1000;
+    uint32_t pipe_temp_poll_idle_interval_ = 10 * 60 * 1000;
+    uint32_t pipe_temp_poll_active_hold_ = 10 * 60 * 1000;
+    // Maximum percentage of bus time used by these requests (AB message + CB response).
+    uint32_t pipe_temp_poll_bus_budget_ = 5;
+    // Set when the external room temperature changed and needs to be sent to the unit. These
+    // sends are rate limited to protect the bus.
+    bool pending_room_temp_send_ = false;
+    optional<float> last_sent_room_temp_{};
+    TokenBucket room_temp_push_limiter_{3, 10 * 1000};
+
+    TempCompensation temp_compensation_;
+
+    // Quantization of the room temperature sent to the unit and the one published to HA.
+    TempQuantizer room_temp_quantizer_;
+    TempQuantizer ha_temp_quantizer_;
+
+    // Power usage from 0xCF messages and the energy integrated from it. Energy is published and
+    // saved to flash at a low rate.
+    SensorWindow power_window_;
+
+    BusTap bus_tap_;
+    esphome::sensor::Sensor* energy_sensor_ = nullptr;
+    optional<uint32_t> last_power_watts_{};
+    EnergyMeter energy_meter_;
+    uint32_t energy_publish_interval_ = 5 * 60 * 1000;
+    uint32_t energy_save_interval_ = 60 * 60 * 1000;
+    uint32_t last_energy_publish_millis_ = 0;
+    uint32_t last_energy_save_millis_ = 0;
+    uint64_t last_saved_energy_watt_millis_ = 0;
+
+    uint32_t ENERGY_STORAGE_VERSION = 3318504U; // Change version if the EnergyStorage struct changes
+    struct EnergyStorage {
+        uint64_t energy_watt_millis = 0;
+    };
+    ESPPreferenceObject energy_pref_;
+
+    // Coil and outdoor unit statistics. Baselines are saved to flash at most once an hour.
+    CoilAnalytics coil_analytics_;
+    static constexpr uint32_t CoilPublishIntervalMillis = 5 * 60 * 1000;
+    static constexpr uint32_t CoilSaveIntervalMillis = 60 * 60 * 1000;
+    uint32_t last_coil_publish_millis_ = 0;
+    uint32_t last_coil_save_millis_ = 0;
+
+    uint32_t COIL_STORAGE_VERSION = 2690417U; // Change version if the CoilStorage struct changes
+    struct CoilStorage {
+        CoilAnalytics::Baseline cooling = {0, 0};
+        CoilAnalytics::Baseline heating = {0, 0};
+    };
+    CoilStorage last_saved_coil_storage_;
+    ESPPreferenceObject coil_pref_;
+
+    // Outdoor/defrost/preheat bits from the last status message and when they last changed.
+    uint8_t last_activity_bits_ = 0;
+    uint32_t last_activity_change_millis_ = 0;
+
+    // Messages we sent but didn't receive back yet.
+    InFlightTable<PendingSendKind> in_flight_;
+
+    // Pending changes, and which messages are sent in the next burst.
+    SendScheduler scheduler_;
+
+    // Installer settings in 0xAD and 0xAE 10 messages (see InstallerSettingFields). Changes are
+    // applied to the last message we received and sent on the next update, so changing several
+    // settings at once only takes one message of each type. Staged bits are kept until we
+    // receive our own message back, so a message from the unit doesn't overwrite them.
+    struct InstallerSettingsMessage {
+        uint8_t data[MsgLen];
+        uint8_t staged_mask[MsgLen];
+        // Set once the matching CD/CE 10 message was received. Until then |data| only holds
+        // staged settings, so changes aren't sent yet.
+        bool received;
+    };
+    InstallerSettingsMessage installer_messages_[2] = {};
+    struct InstallerSettingEntity {
+        const InstallerSettingField* field;
+        LgNumber* number;
+    };
+    std::vector<InstallerSettingEntity> installer_settings_;
+
+    // Some units set the vanes to their default position after changing operation mode or swing
+    // mode, so these changes are followed by a Type A message with our vane positions (see
+    // SendScheduler::request_vane_follow_up). For other status changes, the next 0xCA message
+    // received within VaneCheckMillis after the status message was sent is checked instead and the
+    // vanes are only restored if the unit changed them. `vane_check_pending_` is set when such a
+    // status message is queued and `vane_check_millis_` when the bus engine sent it.
+    bool vane_check_pending_ = false;
+    optional<uint32_t> vane_check_millis_{};
+    static constexpr uint32_t VaneCheckMillis = 10 * 1000;
+
+    // Climate presets. The messages for a preset (status, 0xAA, 0xAB) are sent as one transaction
+    // by the scheduler.
+    std::vector<PresetSettings> presets_;
+
+    // Optional zone switches for duct units (index 0 is zone 1). Zone changes are sent once no
+    // zone switch changed for zone_batch_millis_, so switching several zones (for example from a
+    // scene) results in a single status message.
+    LgSwitch* zone_switches_[MaxZones] = {};
+    optional<uint32_t> zone_change_millis_{};
+    uint32_t zone_batch_millis_ = 2000;
+    bool ignore_zone_callback_ = false;
+    // False until the zone states were received. Until then, the zone bits are sent unchanged.
+    bool zones_known_ = false;
+
+    // DRED (demand response) mode. A change is sent right away as a priority 0xAB message that
+    // also requests a 0xCB response, instead of waiting for update(). The requested mode
+    // overrides the unit's until the unit acknowledges it in a 0xCB message.
+    LgSelect* dred_select_ = nullptr;
+    sensor::Sensor* dred_state_sensor_ = nullptr;
+    sensor::Sensor* dred_latency_sensor_ = nullptr;
+    optional<uint8_t> requested_dred_{};
+    uint32_t dred_request_millis_ = 0;
+    bool ignore_dred_callback_ = false;
+    static constexpr uint32_t DredAckTimeoutMillis = 30 * 1000;
+    // When the bus engine received the message being processed.
+    uint32_t last_recv_event_millis_ = 0;
 
     bool is_initializing_ = true;
 
@@ -205,82 +1129,22 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
 
     const bool fahrenheit_;
 
-    // Whether a message came from the HVAC unit, a master controller, or a slave controller.
-    enum class MessageSender : uint8_t { Unit, Master, Slave };
     // Set if this controller is configured as slave controller.
     const bool slave_;
 
-    enum class LgCapability {
-        PURIFIER,
-        FAN_AUTO,
-        FAN_SLOW,
-        FAN_LOW,
-        FAN_LOW_MEDIUM,
-        FAN_MEDIUM,
-        FAN_MEDIUM_HIGH,
-        FAN_HIGH,
-        MODE_HEATING,
-        MODE_FAN,
-        MODE_AUTO,
-        MODE_DEHUMIDIFY,
-        HAS_ONE_VANE,
-        HAS_TWO_VANES,
-        HAS_FOUR_VANES,
-        VERTICAL_SWING,
-        HORIZONTAL_SWING,
-        HAS_ESP_VALUE_SETTING,
-        OVERHEATING_SETTING,
-        AUTO_DRY,
-    };
+    // Decoded from nvs_storage_.capabilities_message (and CE 00 messages).
+    Capabilities capabilities_;
 
-    bool parse_capability(LgCapability capability) {
-        switch (capability) {
-            case LgCapability::PURIFIER:
-                return (nvs_storage_.capabilities_message[2] & 0x02) != 0;
-            case LgCapability::FAN_AUTO:
-                return (nvs_storage_.capabilities_message[3] & 0x01) != 0;
-            case LgCapability::FAN_SLOW:
-                return (nvs_storage_.capabilities_message[3] & 0x20) != 0;
-            case LgCapability::FAN_LOW:
-                return (nvs_storage_.capabilities_message[3] & 0x10) != 0;
-            case LgCapability::FAN_LOW_MEDIUM:
-                return (nvs_storage_.capabilities_message[6] & 0x08) != 0;
-            case LgCapability::FAN_MEDIUM:
-                return (nvs_storage_.capabilities_message[3] & 0x08) != 0;
-            case LgCapability::FAN_MEDIUM_HIGH:
-                return (nvs_storage_.capabilities_message[6] & 0x10) != 0;
-            case LgCapability::FAN_HIGH:
-                return true;
-            case LgCapability::MODE_HEATING:
-                return (nvs_storage_.capabilities_message[2] & 0x40) != 0;
-            case LgCapability::MODE_FAN:
-                return (nvs_storage_.capabilities_message[2] & 0x80) != 0;
-            case LgCapability::MODE_AUTO:
-                return (nvs_storage_.capabilities_message[2] & 0x08) != 0;
-            case LgCapability::MODE_DEHUMIDIFY:
-                return (nvs_storage_.capabilities_message[2] & 0x80) != 0;
-            case LgCapability::HAS_ONE_VANE:
-                return (nvs_storage_.capabilities_message[5] & 0x40) != 0;
-            case LgCapability::HAS_TWO_VANES:
-                return (nvs_storage_.capabilities_message[5] & 0x80) != 0;
-            case LgCapability::HAS_FOUR_VANES:
-                // Actual flag is unknown, assume 4 vanes if neither 1 nor 2 vanes are supported
-                // and the vane control bit is set.
-                return (nvs_storage_.capabilities_message[5] & 0x40) == 0 &&
-                       (nvs_storage_.capabilities_message[5] & 0x80) == 0 &&
-                       (nvs_storage_.capabilities_message[4] & 0x01) != 0;
-            case LgCapability::VERTICAL_SWING:
-                return (nvs_storage_.capabilities_message[1] & 0x80) != 0;
-            case LgCapability::HORIZONTAL_SWING:
-                return (nvs_storage_.capabilities_message[1] & 0x40) != 0;
-            case LgCapability::HAS_ESP_VALUE_SETTING:
-                return (nvs_storage_.capabilities_message[4] & 0x02) != 0;
-            case LgCapability::OVERHEATING_SETTING:
-                return (nvs_storage_.capabilities_message[7] & 0x80) != 0;
-            case LgCapability::AUTO_DRY:
-                return (nvs_storage_.capabilities_message[4] & 0x80) != 0;
-        }
-        return false;
+    // Zone index 0-7. The bits for zones 5-8 mean other things on most units, so these are only
+    // used if the unit is known to support them.
+    bool is_zone_supported(size_t index) const {
+        if (!capabilities_.known()) {
+            return index < 4;
+        }
+        if (capabilities_.unit_kind() != 2) {
+            return false;
+        }
+        return index < 4 || capabilities_.has(Capability::Zones5To8);
     }
 
     void configure_capabilities() {
@@ -314,42 +1178,51 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
         supported_traits_.set_visual_current_temperature_step(fahrenheit_ ? 1 : 0.5);
         supported_traits_.set_visual_target_temperature_step(fahrenheit_ ? 1 : 0.5);
 
+        if (!presets_.empty()) {
+            climate::ClimatePresetMask presets;
+            presets.insert(climate::CLIMATE_PRESET_NONE);
+            for (const PresetSettings& settings : presets_) {
+                presets.insert(settings.preset);
+            }
+            supported_traits_.set_supported_presets(presets);
+        }
+
         // Only override defaults if the capabilities are known
-        if (nvs_storage_.capabilities_message[0] != 0) {
+        if (capabilities_.known()) {
             // Configure the climate traits
             climate::ClimateModeMask override_device_modes;
             override_device_modes.insert(climate::CLIMATE_MODE_OFF);
             override_device_modes.insert(climate::CLIMATE_MODE_COOL);
-            if (parse_capability(LgCapability::MODE_HEATING))
+            if (capabilities_.has(Capability::ModeHeating))
                 override_device_modes.insert(climate::CLIMATE_MODE_HEAT);
-            if (parse_capability(LgCapability::MODE_FAN))
+            if (capabilities_.has(Capability::ModeFan))
                 override_device_modes.insert(climate::CLIMATE_MODE_FAN_ONLY);
-            if (parse_capability(LgCapability::MODE_AUTO))
+            if (capabilities_.has(Capability::ModeAuto))
                 override_device_modes.insert(climate::CLIMATE_MODE_HEAT_COOL);
-            if (parse_capability(LgCapability::MODE_DEHUMIDIFY))
+            if (capabilities_.has(Capability::ModeDehumidify))
                 override_device_modes.insert(climate::CLIMATE_MODE_DRY);
             supported_traits_.set_supported_modes(override_device_modes);
 
             climate::ClimateFanModeMask override_fan_modes;
-            if (parse_capability(LgCapability::FAN_AUTO))
+            if (capabilities_.has(Capability::FanAuto))
                 override_fan_modes.insert(climate::CLIMATE_FAN_AUTO);
-            if (parse_capability(LgCapability::FAN_SLOW))
+            if (capabilities_.has(Capability::FanSlow))
                 override_fan_modes.insert(climate::CLIMATE_FAN_QUIET);
-            if (parse_capability(LgCapability::FAN_LOW))
+            if (capabilities_.has(Capability::FanLow))
                 override_fan_modes.insert(climate::CLIMATE_FAN_LOW);
-            if (parse_capability(LgCapability::FAN_MEDIUM))
+            if (capabilities_.has(Capability::FanMedium))
                 override_fan_modes.insert(climate::CLIMATE_FAN_MEDIUM);
-            if (parse_capability(LgCapability::FAN_HIGH))
-                override_fan_modes.insert(climate::CLIMATE_FAN_HIGH);
+            // High is always supported. Not all units set its capability bit.
+            override_fan_modes.insert(climate::CLIMATE_FAN_HIGH);
             supported_traits_.set_supported_fan_modes(override_fan_modes);
 
             climate::ClimateSwingModeMask override_swing_modes;
             override_swing_modes.insert(climate::CLIMATE_SWING_OFF);
-            if (parse_capability(LgCapability::VERTICAL_SWING) && parse_capability(LgCapability::HORIZONTAL_SWING))
+            if (capabilities_.has(Capability::VerticalSwing) && capabilities_.has(Capability::HorizontalSwing))
                 override_swing_modes.insert(climate::CLIMATE_SWING_BOTH);
-            if (parse_capability(LgCapability::VERTICAL_SWING))
+            if (capabilities_.has(Capability::VerticalSwing))
                 override_swing_modes.insert(climate::CLIMATE_SWING_VERTICAL);
-            if (parse_capability(LgCapability::HORIZONTAL_SWING))
+            if (capabilities_.has(Capability::HorizontalSwing))
                 override_swing_modes.insert(climate::CLIMATE_SWING_HORIZONTAL);
             supported_traits_.set_supported_swing_modes(override_swing_modes);
 
@@ -359,12 +1232,12 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
             vane_select_3_.set_internal(true);
             vane_select_4_.set_internal(true);
 
-            if (parse_capability(LgCapability::HAS_ONE_VANE)) {
+            if (capabilities_.has(Capability::OneVane)) {
                 vane_select_1_.set_internal(false);
-            } else if (parse_capability(LgCapability::HAS_TWO_VANES)) {
+            } else if (capabilities_.has(Capability::TwoVanes)) {
                 vane_select_1_.set_internal(false);
                 vane_select_2_.set_internal(false);
-            } else if (parse_capability(LgCapability::HAS_FOUR_VANES)) {
+            } else if (capabilities_.has(Capability::FourVanes)) {
                 vane_select_1_.set_internal(false);
                 vane_select_2_.set_internal(false);
                 vane_select_3_.set_internal(false);
@@ -378,35 +1251,56 @@ class LgController final : public climate::Climate, public uart::UARTDevice, pub
             overheating_select_.set_internal(true);
 
             if (!slave_) {
-                if (parse_capability(LgCapability::HAS_ESP_VALUE_SETTING)) {
-                    if (parse_capability(LgCapability::FAN_SLOW)) {
+                if (capabilities_.has(Capability::EspValueSetting)) {
+                    if (capabilities_.has(Capability::FanSlow)) {
                         fan_speed_slow_.set_internal(false);
                     }
-                    if (parse_capability(LgCapability::FAN_LOW)) {
+                    if (capabilities_.has(Capability::FanLow)) {
                         fan_speed_low_.set_internal(false);
                     }
-                    if (parse_capability(LgCapability::FAN_MEDIUM)) {
+                    if (capabilities_.has(Capability::FanMedium)) {
                         fan_speed_medium_.set_internal(false);
                     }
-                    if (parse_capability(LgCapability::FAN_HIGH)) {
-                        fan_speed_high_.set_internal(false);
-                    }
+                    fan_speed_high_.set_internal(false);
                 }
-                if (parse_capability(LgCapability::OVERHEATING_SETTING)) {
+                if (capabilities_.has(Capability::OverheatingSetting)) {
                     overheating_select_.set_internal(false);
                 }
             }
-            purifier_.set_internal(!parse_capability(LgCapability::PURIFIER));
-            auto_dry_.set_internal(!parse_capability(LgCapability::AUTO_DRY));
-            auto_dry_active_.set_internal(!parse_capability(LgCapability::AUTO_DRY));
+            purifier_.set_internal(!capabilities_.has(Capability::Purifier));
+            auto_dry_.set_internal(!capabilities_.has(Capability::AutoDry));
+            auto_dry_active_.set_internal(!capabilities_.has(Capability::AutoDry));
+        }
+
+        for (size_t i = 0; i < MaxZones; i++) {
+            if (zone_switches_[i] != nullptr) {
+                zone_switches_[i]->set_internal(!is_zone_supported(i));
+            }
+        }
+
+        bool dred_supported = !capabilities_.known() || capabilities_.has(Capability::Dred);
+        if (dred_select_ != nullptr) {
+            dred_select_->set_internal(slave_ || !dred_supported);
+        }
+        if (dred_state_sensor_ != nullptr) {
+            dred_state_sensor_->set_internal(!dred_supported);
+        }
+        if (dred_latency_sensor_ != nullptr) {
+            dred_latency_sensor_->set_internal(slave_ || !dred_supported);
         }
 
         internal_thermistor_.set_internal(slave_);
+
+        for (const InstallerSettingEntity& entity : installer_settings_) {
+            Capability capability = entity.field->capability;
+            bool supported = capability == Capability::Count || !capabilities_.known() ||
+                             capabilities_.has(capability);
+            entity.number->set_internal(slave_ || !supported);
+        }
     }
 
 public:
     LgController(InternalGPIOPin* rx_pin,
-                 sensor::Sensor* temperature_sensor,
                  LgSelect* vane_select_1,
                  LgSelect* vane_select_2,
                  LgSelect* vane_select_3,
@@ -429,8 +1323,7 @@ public:
                  LgSwitch* internal_thermistor,
                  LgSwitch* auto_dry,
                  bool fahrenheit, bool is_slave_controller)
-      : rx_pin_(*rx_pin),
-        temperature_sensor_(temperature_sensor),
+      : rx_pin_(rx_pin),
         vane_select_1_(*vane_select_1),
         vane_select_2_(*vane_select_2),
         vane_select_3_(*vane_select_3),
@@ -455,6 +1348,13 @@ public:
         fahrenheit_(fahrenheit),
         slave_(is_slave_controller)
     {
+        std::fill(std::begin(unit_slots_), std::end(unit_slots_), NoUnitSlot);
+        scheduler_.set_periodic_status(!slave_);
+
+        pipe_temp_in_window_.set_sensor(pipe_temp_in);
+        pipe_temp_mid_window_.set_sensor(pipe_temp_mid);
+        pipe_temp_out_window_.set_sensor(pipe_temp_out);
+
         vane_select_1_.add_on_state_callback([this](size_t index) {
             set_vane_position(1, index);
         });
@@ -488,13 +1388,13 @@ public:
         });
 
         purifier_.add_on_state_callback([this](bool) {
-            pending_status_change_ = true;
+            scheduler_.request(PendingSendKind::Status);
         });
         internal_thermistor_.add_on_state_callback([this](bool) {
-            pending_status_change_ = true;
+            scheduler_.request(PendingSendKind::Status);
         });
         auto_dry_.add_on_state_callback([this](bool) {
-            pending_type_a_settings_change_ = true;
+            scheduler_.request(PendingSendKind::TypeA);
         });
     }
 
@@ -502,10 +1402,188 @@ public:
         return esphome::setup_priority::BUS;
     }
 
+    // Only has an effect on ESP32. Without the task, the bus is polled from the main loop.
+    void set_bus_task(bool bus_task) {
+        bus_task_ = bus_task;
+    }
+
+    void set_passive(bool passive) {
+        passive_ = passive;
+    }
+
+    void add_temperature_sensor(sensor::Sensor* sensor, uint32_t max_age_millis, uint32_t weight_milli) {
+        if (room_temp_inputs_.size() >= MaxRoomTempInputs) {
+            ESP_LOGE(TAG, "Too many temperature sensors");
+            return;
+        }
+        size_t index = room_temp_inputs_.size();
+        room_temp_inputs_.push_back({sensor, max_age_millis, weight_milli, 0});
+        sensor->add_on_state_callback([this, index](float) {
+            room_temp_inputs_[index].last_update_millis = millis();
+            room_temp_changed();
+        });
+    }
+
+    // Fusion modes: 0 = median, 1 = mean, 2 = weighted mean, 3 = min, 4 = max.
+    void set_temperature_fusion(uint8_t fusion) {
+        temp_fusion_ = TempFusion(fusion);
+    }
+
+    void set_room_temp_stale_sensor(binary_sensor::BinarySensor* sensor) {
+        room_temp_stale_sensor_ = sensor;
+    }
+
+    // Zone: 1-8.
+    void add_zone_switch(uint8_t zone, LgSwitch* sw) {
+        if (zone < 1 || zone > MaxZones) {
+            ESP_LOGE(TAG, "Unsupported zone: %u", zone);
+            return;
+        }
+        zone_switches_[zone - 1] = sw;
+        sw->add_on_state_callback([this, zone](bool on) {
+            if (ignore_zone_callback_) {
+                return;
+            }
+            ESP_LOGD(TAG, "Zone %u %s", zone, on ? "on" : "off");
+            zone_change_millis_ = millis();
+        });
+    }
+
+    void set_zone_batch_delay(uint32_t delay_millis) {
+        zone_batch_millis_ = delay_millis;
+    }
+
+    void set_dred_select(LgSelect* select) {
+        dred_select_ = select;
+        select->add_on_state_callback([this](size_t index) {
+            if (!ignore_dred_callback_) {
+                request_dred(index);
+            }
+        });
+    }
+    void set_dred_state_sensor(sensor::Sensor* sensor) {
+        dred_state_sensor_ = sensor;
+    }
+    void set_dred_latency_sensor(sensor::Sensor* sensor) {
+        dred_latency_sensor_ = sensor;
+    }
+
+    // Returns the settings for this preset, adding it if needed.
+    PresetSettings& get_preset(climate::ClimatePreset preset) {
+        for (PresetSettings& settings : presets_) {
+            if (settings.preset == preset) {
+                return settings;
+            }
+        }
+        presets_.push_back({preset});
+        return presets_.back();
+    }
+
+    void set_room_temp_hysteresis(float hysteresis, uint32_t dwell_millis) {
+        room_temp_quantizer_.configure(hysteresis, dwell_millis);
+        ha_temp_quantizer_.configure(hysteresis, dwell_millis);
+    }
+
+    void set_room_temp_push(uint32_t burst, uint32_t refill_interval) {
+        room_temp_push_limiter_.configure(burst, refill_interval);
+    }
+
+    TempCompensation& get_temp_compensation() {
+        return temp_compensation_;
+    }
+
+    void add_installer_setting(uint8_t setting, LgNumber* number) {
+        const InstallerSettingField* field = find_installer_setting(setting);
+        if (field == nullptr) {
+            ESP_LOGE(TAG, "Unsupported installer setting: %u", setting);
+            return;
+        }
+        installer_settings_.push_back({field, number});
+        number->add_on_state_callback([this, field](float v) {
+            stage_installer_setting(*field, v);
+        });
+    }
+
+    void set_unit_address(uint8_t address) {
+        unit_address_ = address;
+    }
+
+    void set_group_units_sensor(text_sensor::TextSensor* sensor) {
+        group_units_sensor_ = sensor;
+    }
+
+    void set_error_history_sensor(text_sensor::TextSensor* sensor) {
+        error_history_sensor_ = sensor;
+    }
+
+    void set_power_sensor(sensor::Sensor* sensor) {
+        power_window_.set_sensor(sensor);
+    }
+
+    SensorWindow& get_pipe_temp_in_window() {
+        return pipe_temp_in_window_;
+    }
+    SensorWindow& get_pipe_temp_mid_window() {
+        return pipe_temp_mid_window_;
+    }
+    SensorWindow& get_pipe_temp_out_window() {
+        return pipe_temp_out_window_;
+    }
+    SensorWindow& get_power_window() {
+        return power_window_;
+    }
+
+    BusTap& get_bus_tap() {
+        return bus_tap_;
+    }
+
+    CoilAnalytics& get_coil_analytics() {
+        return coil_analytics_;
+    }
+
+    void set_energy_sensor(sensor::Sensor* sensor, uint32_t publish_interval, uint32_t save_interval) {
+        energy_sensor_ = sensor;
+        energy_publish_interval_ = publish_interval;
+        energy_save_interval_ = save_interval;
+    }
+
+    void set_pipe_temp_poll(uint32_t active_interval, uint32_t idle_interval,
+                            uint32_t active_hold, uint32_t bus_budget) {
+        pipe_temp_poll_active_interval_ = active_interval;
+        pipe_temp_poll_idle_interval_ = idle_interval;
+        pipe_temp_poll_active_hold_ = active_hold;
+        pipe_temp_poll_bus_budget_ = std::max<uint32_t>(bus_budget, 1);
+    }
+
     void setup() override {
         // Load our custom NVS storage to get the capabilities message
         ESPPreferenceObject pref = global_preferences->make_preference<NVSStorage>(this->get_object_id_hash() ^ NVS_STORAGE_VERSION);
         pref.load(&nvs_storage_);
+        capabilities_.decode(nvs_storage_.capabilities_message);
+
+        if (bus_tap_.enabled() && !BusTap::supported()) {
+            ESP_LOGE(TAG, "bus_tap is only supported on ESP32 and host");
+        }
+
+        if (energy_sensor_ != nullptr) {
+            energy_pref_ = global_preferences->make_preference<EnergyStorage>(this->get_object_id_hash() ^ ENERGY_STORAGE_VERSION);
+            EnergyStorage energy;
+            if (energy_pref_.load(&energy)) {
+                energy_meter_.restore(energy.energy_watt_millis);
+                last_saved_energy_watt_millis_ = energy.energy_watt_millis;
+            }
+            energy_sensor_->publish_state(energy_meter_.energy_kwh());
+        }
+
+        if (coil_analytics_.enabled()) {
+            coil_pref_ = global_preferences->make_preference<CoilStorage>(this->get_object_id_hash() ^ COIL_STORAGE_VERSION);
+            CoilStorage coil;
+            if (coil_pref_.load(&coil)) {
+                coil_analytics_.restore_baseline(CoilAnalytics::Mode::Cooling, coil.cooling);
+                coil_analytics_.restore_baseline(CoilAnalytics::Mode::Heating, coil.heating);
+                last_saved_coil_storage_ = coil;
+            }
+        }
 
         auto restore = this->restore_state_();
         if (restore.has_value()) {
@@ -522,6 +1600,13 @@ public:
 
         sleep_timer_.publish_state(0);
 
+        publish_error_history();
+
+        // After this, check_room_temp_stale only publishes changes.
+        if (room_temp_stale_sensor_ != nullptr) {
+            room_temp_stale_sensor_->publish_state(room_temp_stale_);
+        }
+
         // Configure climate traits and entities based on the capabilities message (if available)
         configure_capabilities();
 
@@ -529,7 +1614,19 @@ public:
             uint8_t b;
             UARTDevice::read_byte(&b);
         }
-        pending_status_change_ = true;
+        bus_io_.init(this, rx_pin_);
+        bus_.init(&bus_io_, millis());
+        bus_.set_listen_only(passive_);
+        if (passive_) {
+            ESP_LOGI(TAG, "passive mode, not sending messages");
+        }
+        if (bus_task_) {
+            bus_task_running_ = bus_.start_task();
+            if (!bus_task_running_) {
+                ESP_LOGW(TAG, "bus task not available, polling from main loop");
+            }
+        }
+        scheduler_.request(PendingSendKind::Status);
 
         // Call `update` every 6 seconds, but first wait 10 seconds.
         set_timeout("initial_send", 10000, [this]() {
@@ -537,9 +1634,41 @@ public:
         });
     }
 
+    void loop() override {
+        if (!bus_task_running_) {
+            bus_.poll(millis());
+        }
+
+        // Decode received messages right away so the published state follows the bus. update()
+        // only decides what to send.
+        BusEvent event;
+        while (bus_.pop_event(&event)) {
+            process_bus_event(event, &had_error_);
+        }
+        if (uint32_t lost = bus_.take_lost_events()) {
+            ESP_LOGE(TAG, "lost %" PRIu32 " bus events", lost);
+        }
+    }
+
     // Process changes from HA.
     void control(const climate::ClimateCall &call) override {
+        if (passive_) {
+            ESP_LOGW(TAG, "passive mode, ignoring change");
+            this->publish_state();
+            return;
+        }
+        if (call.get_preset().has_value()) {
+            apply_preset(*call.get_preset());
+        } else if (!presets_.empty() &&
+                   (call.get_mode().has_value() || call.get_target_temperature().has_value() ||
+                    call.get_fan_mode().has_value() || call.get_swing_mode().has_value())) {
+            // A manual change ends the preset.
+            this->preset = climate::CLIMATE_PRESET_NONE;
+        }
         if (call.get_mode().has_value()) {
+            if (this->mode != *call.get_mode()) {
+                scheduler_.request_vane_follow_up();
+            }
             this->mode = *call.get_mode();
         }
         if (call.get_target_temperature().has_value()) {
@@ -549,9 +1678,12 @@ public:
             this->fan_mode = *call.get_fan_mode();
         }
         if (call.get_swing_mode().has_value()) {
+            if (this->swing_mode != *call.get_swing_mode()) {
+                scheduler_.request_vane_follow_up();
+            }
             set_swing_mode(*call.get_swing_mode());
         }
-        this->pending_status_change_ = true;
+        scheduler_.request(PendingSendKind::Status);
         this->publish_state();
     }
 
@@ -576,7 +1708,7 @@ private:
         ESP_LOGD(TAG, "Setting vane %d position: %d", index, position);
         vane_position_[index-1] = position;
         if (!is_initializing_) {
-            pending_type_a_settings_change_ = true;
+            scheduler_.request(PendingSendKind::TypeA);
         }
     }
 
@@ -597,7 +1729,26 @@ private:
 
         fan_speed_[index] = value;
         if (!is_initializing_) {
-            pending_type_a_settings_change_ = true;
+            scheduler_.request(PendingSendKind::TypeA);
+        }
+    }
+
+    void stage_installer_setting(const InstallerSettingField& field, int value) {
+        if (slave_) {
+            return;
+        }
+        if (value < 0 || value > installer_setting_max(field)) {
+            ESP_LOGE(TAG, "Unexpected value for installer setting %u: %d", field.setting, value);
+            return;
+        }
+        InstallerSettingsMessage& msg = installer_messages_[size_t(field.message)];
+        if (get_installer_setting(field, msg.data) == value) {
+            return;
+        }
+        set_installer_setting(field, msg.data, value);
+        msg.staged_mask[field.byte] |= field.mask;
+        if (!is_initializing_ && msg.received) {
+            scheduler_.request(installer_kind(field.message));
         }
     }
 
@@ -616,7 +1767,28 @@ private:
 
         overheating_ = value;
         if (!is_initializing_) {
-            pending_type_b_settings_change_ = true;
+            scheduler_.request(PendingSendKind::TypeB);
+        }
+    }
+
+    void request_dred(int mode) {
+        if (mode < 0 || mode > 3) {
+            ESP_LOGE(TAG, "Unexpected DRED mode: %d", mode);
+            return;
+        }
+        if (slave_ || passive_) {
+            ESP_LOGW(TAG, "Not sending DRED mode from slave or passive controller");
+            return;
+        }
+        ESP_LOGD(TAG, "Setting DRED mode: %d", mode);
+        requested_dred_ = mode;
+        dred_request_millis_ = millis();
+        // Send it now unless we don't have the unit's settings yet or the in-flight table is
+        // full. Then it's sent with the next burst.
+        bool ready = !is_initializing_ &&
+                     (last_recv_type_b_settings_[0] == 0xCB || last_recv_type_b_settings_[0] == 0xAB);
+        if (scheduler_.send_priority(PendingSendKind::TypeB, ready, in_flight_)) {
+            send_type_b_settings_message(/* timed = */ false, /* priority = */ true);
         }
     }
 
@@ -637,29 +1809,140 @@ private:
             sleep_timer_target_millis_.reset();
             active_reservation_ = false;
         }
-        pending_status_change_ = true;
+        scheduler_.request(PendingSendKind::Status);
+    }
+
+    // Called when the external temperature sensor has a new value. Schedules a status message if
+    // the value we'd send to the unit changed.
+    void room_temp_changed() {
+        if (slave_ || internal_thermistor_.state) {
+            return;
+        }
+        optional<float> temp = get_room_temp();
+        if (!temp.has_value() || temp == last_sent_room_temp_) {
+            return;
+        }
+        if (!pending_room_temp_send_) {
+            ESP_LOGD(TAG, "room temperature changed to %.1f", *temp);
+        }
+        pending_room_temp_send_ = true;
+    }
+
+    // Returns the external room temperature in Celsius (LG-Celsius in Fahrenheit mode), or nothing
+    // if it's not available. Values from multiple sensors are combined based on temp_fusion_.
+    optional<float> get_measured_room_temp() const {
+        float values[MaxRoomTempInputs];
+        uint32_t weights[MaxRoomTempInputs];
+        size_t count = 0;
+
+        uint32_t millis_now = millis();
+        for (const RoomTempInput& input : room_temp_inputs_) {
+            float temp = input.sensor->get_state();
+            if (std::isnan(temp) || temp == 0) {
+                continue;
+            }
+            if (input.max_age_millis > 0 && millis_now - input.last_update_millis > input.max_age_millis) {
+                continue;
+            }
+            values[count] = temp;
+            weights[count] = input.weight_milli;
+            count++;
+        }
+        if (count == 0) {
+            return {};
+        }
+
+        float temp;
+        switch (temp_fusion_) {
+            case TempFusion::Median: {
+                std::sort(values, values + count);
+                temp = (count & 1) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+                break;
+            }
+            case TempFusion::Mean:
+            case TempFusion::WeightedMean: {
+                float sum = 0;
+                uint32_t total_weight = 0;
+                for (size_t i = 0; i < count; i++) {
+                    uint32_t weight = temp_fusion_ == TempFusion::Mean ? 1 : weights[i];
+                    sum += values[i] * weight;
+                    total_weight += weight;
+                }
+                if (total_weight == 0) {
+                    return {};
+                }
+                temp = sum / total_weight;
+                break;
+            }
+            case TempFusion::Min:
+                temp = *std::min_element(values, values + count);
+                break;
+            case TempFusion::Max:
+                temp = *std::max_element(values, values + count);
+                break;
+            default:
+                return {};
+        }
+
+        if (fahrenheit_) {
+            temp = TempConversion::fahrenheit_to_lgcelsius(temp);
+        }
+        return temp;
+    }
+
+    // Checks if all external temperature sensors are stale. When this changes, send a status
+    // message soon to switch the unit to its own thermistor (or back).
+    void check_room_temp_stale() {
+        if (room_temp_inputs_.empty() || internal_thermistor_.state) {
+            return;
+        }
+        bool stale = !get_measured_room_temp().has_value();
+        if (stale == room_temp_stale_) {
+            return;
+        }
+        room_temp_stale_ = stale;
+        if (stale) {
+            ESP_LOGW(TAG, "No valid room temperature, using unit thermistor");
+        } else {
+            ESP_LOGW(TAG, "Room temperature available again");
+        }
+        if (room_temp_stale_sensor_ != nullptr) {
+            room_temp_stale_sensor_->publish_state(stale);
+        }
+        pending_room_temp_send_ = true;
+    }
+
+    int32_t get_setpoint_centi() const {
+        float target = this->target_temperature;
+        if (fahrenheit_) {
+            target = TempConversion::celsius_to_lgcelsius(target);
+        }
+        return int32_t(lroundf(target * 100));
     }
 
-    optional<float> get_room_temp() const {
-        if (temperature_sensor_ == nullptr) {
+    // Returns the room temperature to send to the unit, with compensation applied.
+    optional<float> get_room_temp() {
+        optional<float> measured = get_measured_room_temp();
+        if (!measured.has_value()) {
             return {};
         }
-
-        float temp = temperature_sensor_->get_state();
-        if (std::isnan(temp) || temp == 0) {
-            return {};
-        }
-        if (fahrenheit_) {
-            temp = TempConversion::fahrenheit_to_lgcelsius(temp);
-        }
-        if (temp < 11) {
-            return 11;
+        float temp = *measured;
+        if (temp_compensation_.enabled()) {
+            int32_t correction = temp_compensation_.correction(this->mode, lroundf(temp * 100),
+                                                               get_setpoint_centi());
+            temp += float(correction) / 100;
         }
-        if (temp > 35) {
-            return 35;
-        }
-        // Round to nearest 0.5 degrees.
-        return round(temp * 2) / 2;
+        return room_temp_quantizer_.quantize(temp, millis());
+    }
+
+    // Returns the interval for requesting pipe temperatures with a timed AB message.
+    uint32_t get_pipe_temp_poll_interval(uint32_t millis_now) const {
+        bool active = last_activity_bits_ != 0 ||
+                      millis_now - last_activity_change_millis_ < pipe_temp_poll_active_hold_;
+        uint32_t interval = active ? pipe_temp_poll_active_interval_ : pipe_temp_poll_idle_interval_;
+        // Each request takes two messages on the bus: our AB message and the CB response.
+        uint32_t min_interval = 2 * MsgWireMillis * 100 / pipe_temp_poll_bus_budget_;
+        return std::max(interval, min_interval);
     }
 
     optional<uint32_t> get_sleep_timer_minutes() const {
@@ -674,31 +1957,182 @@ private:
         return minutes;
     }
 
-    static uint8_t calc_checksum(const uint8_t* buffer) {
-        size_t result = 0;
-        for (size_t i = 0; i < 12; i++) {
-            result += buffer[i];
-        }
-        return (result & 0xff) ^ 0x55;
-    }
-
     void set_swing_mode(climate::ClimateSwingMode mode) {
         if (this->swing_mode != mode) {
             // If vertical swing is off, send a 0xAA message to restore the vane position.
             if (mode == climate::CLIMATE_SWING_OFF || mode == climate::CLIMATE_SWING_HORIZONTAL) {
-                pending_type_a_settings_change_ = true;
+                scheduler_.request(PendingSendKind::TypeA);
             }
         }
         this->swing_mode = mode;
     }
 
-    void send_status_message() {
+    void apply_preset(climate::ClimatePreset preset) {
+        this->preset = preset;
+        if (preset == climate::CLIMATE_PRESET_NONE) {
+            return;
+        }
+        const PresetSettings* settings = nullptr;
+        for (const PresetSettings& s : presets_) {
+            if (s.preset == preset) {
+                settings = &s;
+            }
+        }
+        if (settings == nullptr) {
+            ESP_LOGE(TAG, "Unknown preset: %d", int(preset));
+            return;
+        }
+        ESP_LOGD(TAG, "Applying preset %d", int(preset));
+
+        // Status message.
+        if (settings->mode.has_value()) {
+            if (this->mode != *settings->mode) {
+                scheduler_.request_vane_follow_up();
+            }
+            this->mode = *settings->mode;
+        }
+        if (settings->target_temperature.has_value()) {
+            this->target_temperature = *settings->target_temperature;
+        }
+        if (settings->fan_mode.has_value()) {
+            this->fan_mode = *settings->fan_mode;
+        }
+        if (settings->swing_mode.has_value()) {
+            if (this->swing_mode != *settings->swing_mode) {
+                scheduler_.request_vane_follow_up();
+            }
+            set_swing_mode(*settings->swing_mode);
+        }
+        if (settings->purifier.has_value()) {
+            purifier_.publish_state(*settings->purifier);
+        }
+        if (settings->sleep_timer_minutes.has_value()) {
+            sleep_timer_.publish_state(*settings->sleep_timer_minutes);
+        }
+        scheduler_.request(PendingSendKind::Status);
+
+        // 0xAA and 0xAB messages. The entity callbacks mark these as pending.
+        LgSelect* vane_selects[4] = {&vane_select_1_, &vane_select_2_, &vane_select_3_, &vane_select_4_};
+        for (size_t i = 0; i < 4; i++) {
+            if (settings->vanes[i].has_value()) {
+                vane_selects[i]->publish_state(*vane_selects[i]->at(*settings->vanes[i]));
+            }
+        }
+        if (settings->overheating.has_value()) {
+            overheating_select_.publish_state(*overheating_select_.at(*settings->overheating));
+        }
+
+        scheduler_.begin_preset(is_initializing_);
+    }
+
+    // Queues the message in send_buf_ and adds it to the in-flight table. The bus engine sends it
+    // when the line is idle. Priority messages skip the messages already queued in the bus engine.
+    void send_message(PendingSendKind kind, bool priority = false) {
+        ESP_LOGD(TAG, "queueing %s", format_hex_pretty(send_buf_, MsgLen).c_str());
+        if (in_flight_.full()) {
+            ESP_LOGE(TAG, "too many messages in flight");
+            return;
+        }
+        bool queued = priority ? bus_.queue_priority_message(send_buf_, millis())
+                               : bus_.queue_message(send_buf_, millis());
+        if (!queued) {
+            ESP_LOGE(TAG, "send queue full");
+            set_pending(kind);
+            return;
+        }
+        in_flight_.add(send_buf_, kind);
+    }
+
+    static PendingSendKind installer_kind(InstallerMessage type) {
+        return type == InstallerMessage::Type5 ? PendingSendKind::Installer5 : PendingSendKind::Installer6;
+    }
+
+    // Marks a message of this kind as pending so it's sent again on a later update.
+    void set_pending(PendingSendKind kind) {
+        switch (scheduler_.retry(kind)) {
+            case SendScheduler::RetryResult::None:
+                break;
+            case SendScheduler::RetryResult::PresetRetry:
+                ESP_LOGW(TAG, "preset message not verified, sending all preset messages again");
+                break;
+            case SendScheduler::RetryResult::PresetFailed:
+                ESP_LOGE(TAG, "preset not applied after %u attempts", scheduler_.preset_attempts());
+                break;
+        }
+    }
+
+    // In passive mode, changes from HA (and from publishing received state) are never sent. Drop
+    // them so received messages aren't ignored because of a pending change.
+    void discard_local_changes() {
+        scheduler_.discard();
+        pending_room_temp_send_ = false;
+        zone_change_millis_.reset();
+    }
+
+    void process_bus_event(const BusEvent& event, bool* had_error) {
+        if (passive_) {
+            discard_local_changes();
+        }
+        switch (event.kind) {
+            case BusEventKind::Received:
+                last_recv_event_millis_ = event.millis;
+                bus_tap_.add(CaptureDirection::Received, event.data, event.millis);
+                process_message(event.data, had_error);
+                break;
+            case BusEventKind::Sent: {
+                ESP_LOGD(TAG, "sent %s", format_hex_pretty(event.data, MsgLen).c_str());
+                bus_tap_.add(CaptureDirection::Sent, event.data, event.millis);
+                PendingSendKind kind;
+                if (in_flight_.mark_sent(event.data, event.millis, &kind) &&
+                    kind == PendingSendKind::Status && vane_check_pending_) {
+                    vane_check_pending_ = false;
+                    vane_check_millis_ = event.millis;
+                }
+                break;
+            }
+            case BusEventKind::Dropped: {
+                ESP_LOGD(TAG, "line busy, not sending %s", format_hex_pretty(event.data, MsgLen).c_str());
+                PendingSendKind kind;
+                if (in_flight_.take_unsent(event.data, &kind)) {
+                    set_pending(kind);
+                }
+                break;
+            }
+            case BusEventKind::Discarded:
+                ESP_LOGE(TAG, "discarding incomplete data %s",
+                         format_hex_pretty(event.data, event.len).c_str());
+                break;
+        }
+    }
+
+    // Returns true and removes the message from the in-flight table if we sent this message.
+    bool verify_sent_message(const uint8_t* buffer) {
+        PendingSendKind kind;
+        if (!in_flight_.take(buffer, &kind)) {
+            return false;
+        }
+        ESP_LOGD(TAG, "verified send");
+        if (scheduler_.verified(kind)) {
+            ESP_LOGD(TAG, "preset applied");
+        }
+        if (kind == PendingSendKind::Installer5 || kind == PendingSendKind::Installer6) {
+            // Only clear staged bits that weren't changed again after sending.
+            InstallerSettingsMessage& msg = installer_messages_[kind == PendingSendKind::Installer5 ? 0 : 1];
+            for (size_t b = 1; b < MsgLen - 1; b++) {
+                msg.staged_mask[b] &= buffer[b] ^ msg.data[b];
+            }
+        }
+        return true;
+    }
+
+    // `change` is set if this sends a pending change instead of just the current state.
+    void send_status_message(bool change) {
         // Byte 0: message type.
         send_buf_[0] = slave_ ? 0x28 : 0xA8;
 
         // Byte 1: changed flag (0x1), power on (0x2), mode (0x1C), fan speed (0x70).
         uint8_t b = 0;
-        if (pending_status_change_) {
+        if (change) {
             b |= 0x1;
         }
         switch (this->mode) {
@@ -814,6 +2248,10 @@ private:
         ThermistorSetting thermistor =
             internal_thermistor_.state ? ThermistorSetting::Unit : ThermistorSetting::Controller;
         float temp;
+        optional<float> measured = get_measured_room_temp();
+        if (measured.has_value() && temp_compensation_.enabled()) {
+            temp_compensation_.step(this->mode, lroundf(*measured * 100), get_setpoint_centi(), millis());
+        }
         if (auto maybe_temp = get_room_temp()) {
             temp = *maybe_temp;
         } else {
@@ -848,23 +2286,44 @@ private:
             send_buf_[9] = *minutes & 0xff;
         }
 
+        // Zone bits in bytes 5 and 10.
+        if (zones_known_ && !is_initializing_) {
+            for (size_t i = 0; i < MaxZones; i++) {
+                if (zone_switches_[i] == nullptr || !is_zone_supported(i)) {
+                    continue;
+                }
+                const ZoneBit& bit = ZoneBits[i];
+                if (zone_switches_[i]->state) {
+                    send_buf_[bit.byte] |= bit.mask;
+                } else {
+                    send_buf_[bit.byte] &= ~bit.mask;
+                }
+            }
+        }
+        if (change) {
+            zone_change_millis_.reset();
+        }
+
         // Byte 11.
         send_buf_[11] = last_recv_status_[11];
 
         // Byte 12.
         send_buf_[12] = calc_checksum(send_buf_);
 
-        ESP_LOGD(TAG, "sending %s", format_hex_pretty(send_buf_, MsgLen).c_str());
-        UARTDevice::write_array(send_buf_, MsgLen);
+        send_message(PendingSendKind::Status);
 
-        pending_status_change_ = false;
-        pending_send_ = PendingSendKind::Status;
-        last_sent_status_millis_ = millis();
+        pending_room_temp_send_ = false;
+        if (thermistor == ThermistorSetting::Controller) {
+            last_sent_room_temp_ = temp;
+        } else {
+            last_sent_room_temp_.reset();
+        }
 
-        // If we sent an updated temperature to the AC, update temperature in HA too.
+        // If we sent an updated temperature to the AC, update temperature in HA too. This is the
+        // measured temperature, without temperature compensation.
         // Slave controller temperature sensor is ignored.
         if (!slave_ && thermistor == ThermistorSetting::Controller) {
-            float ha_temp = temp;
+            float ha_temp = ha_temp_quantizer_.quantize(*measured, millis());
             if (fahrenheit_) {
                 ha_temp = TempConversion::lgcelsius_to_celsius(ha_temp);
             }
@@ -878,7 +2337,6 @@ private:
     void send_type_a_settings_message() {
         if (last_recv_type_a_settings_[0] != 0xCA && last_recv_type_a_settings_[0] != 0xAA) {
             ESP_LOGE(TAG, "Unexpected missing previous CA/AA message");
-            pending_type_a_settings_change_ = false;
             return;
         }
 
@@ -907,20 +2365,15 @@ private:
 
         send_buf_[12] = calc_checksum(send_buf_);
 
-        ESP_LOGD(TAG, "sending %s", format_hex_pretty(send_buf_, MsgLen).c_str());
-        UARTDevice::write_array(send_buf_, MsgLen);
-
-        pending_type_a_settings_change_ = false;
-        pending_send_ = PendingSendKind::TypeA;
+        send_message(PendingSendKind::TypeA);
     }
 
-    void send_type_b_settings_message(bool timed) {
+    void send_type_b_settings_message(bool timed, bool priority = false) {
         if (timed) {
             ESP_LOGD(TAG, "sending timed AB message");
         }
         if (last_recv_type_b_settings_[0] != 0xCB && last_recv_type_b_settings_[0] != 0xAB) {
             ESP_LOGE(TAG, "Unexpected missing previous CB/AB message");
-            pending_type_b_settings_change_ = false;
             // Don't try to send another message immediately after.
             last_sent_recv_type_b_millis_ = millis();
             return;
@@ -930,26 +2383,47 @@ private:
         memcpy(send_buf_, last_recv_type_b_settings_, MsgLen);
         send_buf_[0] = slave_ ? 0x2B : 0xAB;
 
-        // Set the high bit of the second byte to request a CB message from the unit.
-        if (timed) {
+        // Set the high bit of the second byte to request a CB message from the unit. Also do this
+        // for a DRED change so the unit acknowledges it right away.
+        if (timed || requested_dred_.has_value()) {
             send_buf_[1] |= 0x80;
         } else {
             send_buf_[1] &= ~0x80;
         }
 
+        // Byte 1 also stores the DRED mode.
+        if (requested_dred_.has_value()) {
+            send_buf_[1] = (send_buf_[1] & ~0x3) | *requested_dred_;
+        }
+
         // Byte 2 stores installer setting 15.
         send_buf_[2] = (send_buf_[2] & 0xC7) | (overheating_ << 3);
 
         send_buf_[12] = calc_checksum(send_buf_);
 
-        ESP_LOGD(TAG, "sending %s", format_hex_pretty(send_buf_, MsgLen).c_str());
-        UARTDevice::write_array(send_buf_, MsgLen);
+        send_message(PendingSendKind::TypeB, priority);
 
-        pending_type_b_settings_change_ = false;
-        pending_send_ = PendingSendKind::TypeB;
         last_sent_recv_type_b_millis_ = millis();
     }
 
+    void send_installer_settings_message(InstallerMessage type) {
+        InstallerSettingsMessage& msg = installer_messages_[size_t(type)];
+        if (!msg.received) {
+            ESP_LOGE(TAG, "Unexpected missing previous CD/CE 10 message");
+            return;
+        }
+        memcpy(send_buf_, msg.data, MsgLen);
+        if (type == InstallerMessage::Type5) {
+            send_buf_[0] = 0xAD;
+        } else {
+            send_buf_[0] = 0xAE;
+            send_buf_[1] = 0x10;
+        }
+        send_buf_[12] = calc_checksum(send_buf_);
+
+        send_message(installer_kind(type));
+    }
+
     void process_message(const uint8_t* buffer, bool* had_error) {
         ESP_LOGD(TAG, "received %s", format_hex_pretty(buffer, MsgLen).c_str());
 
@@ -966,54 +2440,127 @@ private:
             return;
         }
 
-        if (pending_send_ != PendingSendKind::None && memcmp(send_buf_, buffer, MsgLen) == 0) {
-            ESP_LOGD(TAG, "verified send");
-            pending_send_ = PendingSendKind::None;
+        if (verify_sent_message(buffer)) {
             return;
         }
 
         // Determine message type.
-        optional<MessageSender> sender;
-        switch (buffer[0] & 0xf8) {
-            case 0xC8:
-                sender = MessageSender::Unit;
+        MessageSender sender = get_message_sender(buffer);
+        switch (sender) {
+            case MessageSender::Unit:
                 break;
-            case 0xA8:
-                if (!slave_) {
+            case MessageSender::Master:
+                if (!slave_ && !passive_) {
                     // Ignore (our own?) master controller messages.
                     return;
                 }
-                sender = MessageSender::Master;
                 break;
-            case 0x28:
+            case MessageSender::Slave:
                 if (slave_) {
                     // Ignore (our own?) slave controller messages.
                     return;
                 }
-                sender = MessageSender::Slave;
                 break;
             default:
                 return; // Unknown message sender. Ignore.
         }
 
-        switch (buffer[0] & 0b111) {
+        switch (get_message_type(buffer)) {
             case 0: // 0xC8/A8/28
-                process_status_message(*sender, buffer, had_error);
+                process_status_message(sender, buffer, had_error);
                 break;
             case 1: // 0xC9
-                process_capabilities_message(*sender, buffer);
+                process_capabilities_message(sender, buffer);
                 break;
             case 2: // 0xCA/AA/2A
-                process_type_a_settings_message(*sender, buffer);
+                process_type_a_settings_message(sender, buffer);
                 break;
             case 3: // 0xCB/AB/2B
-                process_type_b_settings_message(*sender, buffer);
+                process_type_b_settings_message(sender, buffer);
+                break;
+            case 5: // 0xCD
+                process_installer_settings_message(InstallerMessage::Type5, sender, buffer);
+                break;
+            case 6: // 0xCE
+                process_type_6_message(sender, buffer);
+                break;
+            case 7: // 0xCF
+                process_power_message(sender, buffer);
                 break;
             default:
                 return;
         }
     }
 
+    void record_error_code(uint8_t code) {
+        if (last_error_code_ == code) {
+            return;
+        }
+        ErrorHistory& history = get_error_history();
+        uint32_t id = this->get_object_id_hash();
+        if (!last_error_code_.has_value()) {
+            // First status message after booting. Only record a change from the last code we
+            // recorded before the reset (no record means no error).
+            uint8_t prev_code = 0;
+            for (uint32_t i = 0; i < history.count; i++) {
+                if (history.get(i).controller == id) {
+                    prev_code = history.get(i).code;
+                    break;
+                }
+            }
+            last_error_code_ = prev_code;
+            if (prev_code == code) {
+                return;
+            }
+        }
+        last_error_code_ = code;
+
+        const char* desc = describe_error_code(code);
+        if (code == 0) {
+            ESP_LOGW(TAG, "error cleared");
+        } else {
+            ESP_LOGW(TAG, "error CH%02u: %s", code, desc ? desc : "unknown");
+        }
+        history.add(id, code, millis() / 1000);
+        publish_error_history();
+    }
+
+    // Most recent first, for example: "CH05 Indoor/outdoor communication (boot 2, 0:01:05); OK (...)".
+    void publish_error_history() {
+        if (error_history_sensor_ == nullptr) {
+            return;
+        }
+        // Home Assistant truncates states longer than 255 characters.
+        static constexpr size_t MaxLength = 255;
+        const ErrorHistory& history = get_error_history();
+        uint32_t id = this->get_object_id_hash();
+        std::string result;
+        for (uint32_t i = 0; i < history.count; i++) {
+            const ErrorHistory::Entry& entry = history.get(i);
+            if (entry.controller != id) {
+                continue;
+            }
+            std::string item;
+            if (entry.code == 0) {
+                item = "OK";
+            } else {
+                const char* desc = describe_error_code(entry.code);
+                item = str_sprintf("CH%02u %s", entry.code, desc ? desc : "Unknown");
+            }
+            item += str_sprintf(" (boot %" PRIu32 ", %" PRIu32 ":%02" PRIu32 ":%02" PRIu32 ")", entry.boot,
+                                entry.uptime_seconds / 3600, (entry.uptime_seconds / 60) % 60,
+                                entry.uptime_seconds % 60);
+            if (result.size() + item.size() + 2 > MaxLength) {
+                break;
+            }
+            if (!result.empty()) {
+                result += "; ";
+            }
+            result += item;
+        }
+        error_history_sensor_->publish_state(result.empty() ? "None" : result);
+    }
+
     void process_status_message(MessageSender sender, const uint8_t* buffer, bool* had_error) {
         // If we just had a failure, ignore this messsage because it might be invalid too.
         if (*had_error) {
@@ -1023,8 +2570,9 @@ private:
         }
 
         // Consider slave controller initialized if we received a status message from the other
-        // controller or the unit.
-        if (slave_) {
+        // controller or the unit. In passive mode, we never request the settings so don't wait
+        // for them.
+        if (slave_ || passive_) {
             is_initializing_ = false;
         }
 
@@ -1036,6 +2584,7 @@ private:
 
         if (sender == MessageSender::Unit) {
             error_code_.publish_state(buffer[11]);
+            record_error_code(buffer[11]);
         }
 
         // When turning on the outdoor unit, the AC sometimes reports ON => OFF => ON within a
@@ -1052,6 +2601,18 @@ private:
             last_outdoor_change_millis_ = millis();
         }
 
+        // Track outdoor unit/defrost/preheat activity to adjust the pipe temperature poll rate.
+        // Only the unit's messages are used for this because controllers echo stale bits.
+        if (sender == MessageSender::Unit) {
+            uint8_t activity_bits = (buffer[3] & (0x4 | 0x8)) | ((buffer[5] & 0x4) << 2);
+            if (activity_bits != last_activity_bits_) {
+                ESP_LOGD(TAG, "activity changed (0x%02x => 0x%02x)", last_activity_bits_, activity_bits);
+                last_activity_bits_ = activity_bits;
+                last_activity_change_millis_ = millis();
+            }
+            coil_analytics_.update_activity(outdoor_on, buffer[3] & 0x4, buffer[3] & 0x8, millis());
+        }
+
         if (sender == MessageSender::Unit && !auto_dry_.is_internal()) {
             bool unit_off = (buffer[1] & 0x2) == 0;
             bool drying = (buffer[10] & 0x10) && unit_off;
@@ -1062,14 +2623,18 @@ private:
         if (slave_) {
             // Let the slave controller report the temperature from the master.
             read_temp = (sender == MessageSender::Master);
+        } else if (passive_) {
+            read_temp = (sender != MessageSender::Slave);
         } else {
             // Report the unit's room temperature only if we're using the internal thermistor.
             // With an external temperature sensor, some units report the temperature we sent and
             // others always send the internal temperature.
-            read_temp = (sender == MessageSender::Unit && internal_thermistor_.state);
+            // Also report it if we're falling back to the unit's thermistor because the external
+            // temperature is missing.
+            read_temp = (sender == MessageSender::Unit && (internal_thermistor_.state || room_temp_stale_));
         }
         if (read_temp) {
-            float room_temp = float(buffer[7] & 0x3F) / 2 + 10;
+            float room_temp = float(decode_status_message(buffer).room_temp_x2) / 2;
             if (fahrenheit_) {
                 room_temp = TempConversion::lgcelsius_to_celsius(room_temp);
             }
@@ -1081,11 +2646,11 @@ private:
 
         // Don't update our settings if we have a pending change/send, because else we overwrite
         // changes we still have to send (or are sending) to the AC.
-        if (pending_status_change_) {
+        if (scheduler_.is_pending(PendingSendKind::Status)) {
             ESP_LOGD(TAG, "ignoring because pending change");
             return;
         }
-        if (pending_send_ == PendingSendKind::Status) {
+        if (in_flight_.contains(PendingSendKind::Status)) {
             ESP_LOGD(TAG, "ignoring because pending send");
             return;
         }
@@ -1147,6 +2712,21 @@ private:
 
         purifier_.publish_state(buffer[2] & 0x4);
 
+        // Keep local zone changes that weren't sent yet, except before the first status message
+        // because the other zones aren't known then.
+        if (!zone_change_millis_.has_value() || !zones_known_) {
+            ignore_zone_callback_ = true;
+            for (size_t i = 0; i < MaxZones; i++) {
+                if (zone_switches_[i] != nullptr && is_zone_supported(i)) {
+                    const ZoneBit& bit = ZoneBits[i];
+                    zone_switches_[i]->publish_state(buffer[bit.byte] & bit.mask);
+                }
+            }
+            ignore_zone_callback_ = false;
+            zone_change_millis_.reset();
+            zones_known_ = true;
+        }
+
         bool horiz_swing = buffer[2] & 0x40;
         bool vert_swing = buffer[2] & 0x80;
         if (horiz_swing && vert_swing) {
@@ -1159,10 +2739,7 @@ private:
             set_swing_mode(climate::CLIMATE_SWING_OFF);
         }
 
-        float target = float((buffer[6] & 0xf) + 15);
-        if (buffer[5] & 0x1) {
-            target += 0.5;
-        }
+        float target = float(decode_status_message(buffer).setpoint_x2) / 2;
         if (fahrenheit_) {
             target = TempConversion::lgcelsius_to_celsius(target);
         }
@@ -1204,8 +2781,16 @@ private:
             if (needsRestart) {
                 pref.save(&nvs_storage_);
                 global_preferences->sync();
+#ifdef USE_HOST
+                // Restarting exits the process on the host platform. Apply the capabilities
+                // directly instead. Home Assistant picks up the new traits when it reconnects.
+                ESP_LOGD(TAG, "applying initial capabilities");
+                capabilities_.decode(nvs_storage_.capabilities_message);
+                configure_capabilities();
+#else
                 ESP_LOGD(TAG, "restarting to apply initial capabilities");
                 App.safe_reboot();
+#endif
             }
             else {
                 ESP_LOGD(TAG, "updated device capabilities, manual restart required to take effect");
@@ -1215,50 +2800,110 @@ private:
         is_initializing_ = false;
     }
 
+    // Returns the state for the unit with this address, or nullptr if there are too many units.
+    UnitState* get_unit(uint8_t address) {
+        uint8_t slot = unit_slots_[address];
+        if (slot != NoUnitSlot) {
+            return &units_[slot];
+        }
+        if (units_.size() == MaxUnits) {
+            return nullptr;
+        }
+        unit_slots_[address] = units_.size();
+        units_.push_back({address, 0, {}});
+        if (!unit_address_.has_value()) {
+            unit_address_ = address;
+        }
+        ESP_LOGI(TAG, "found indoor unit with address %u", address);
+        publish_group_units();
+        return &units_.back();
+    }
+
+    // For example: "2 units: 0, 1 (settings: 0, group control)".
+    void publish_group_units() {
+        if (group_units_sensor_ == nullptr) {
+            return;
+        }
+        std::string result = str_sprintf("%u unit%s", unsigned(units_.size()), units_.size() == 1 ? "" : "s");
+        for (size_t i = 0; i < units_.size(); i++) {
+            result += str_sprintf("%s%u", i == 0 ? ": " : ", ", units_[i].address);
+        }
+        if (unit_address_.has_value()) {
+            result += str_sprintf(" (settings: %u%s)", *unit_address_, group_control_ ? ", group control" : "");
+        }
+        group_units_sensor_->publish_state(result);
+    }
+
     void process_type_a_settings_message(MessageSender sender, const uint8_t* buffer) {
+        if (sender == MessageSender::Unit) {
+            UnitState* unit = get_unit(buffer[1]);
+            if (unit != nullptr) {
+                unit->last_seen_millis = millis();
+                memcpy(unit->type_a_settings, buffer, MsgLen);
+            }
+            // Settings from other units in the group are tracked but not shown.
+            if (buffer[1] != unit_address_) {
+                return;
+            }
+        }
+
         // Send settings the first time we receive a 0xCA message.
         if (sender != MessageSender::Slave) {
             bool first_time = last_recv_type_a_settings_[0] == 0;
             memcpy(last_recv_type_a_settings_, buffer, MsgLen);
             if (first_time) {
-                pending_type_a_settings_change_ = true;
+                scheduler_.request(PendingSendKind::TypeA);
             }
         }
 
-        // Handle vane 1 position change
-        uint8_t vane1 = buffer[7] & 0x0F;
-        if (vane1 <= 6) {
-            vane_position_[0] = vane1;
-            vane_select_1_.publish_state(*vane_select_1_.at(vane1));
-        } else {
-            ESP_LOGE(TAG, "Unexpected vane 1 position: %u", vane1);
+        // If the unit changed the vanes after a status change we sent, restore our positions
+        // instead of taking over the unit's defaults.
+        bool restore_vanes = false;
+        if (sender == MessageSender::Unit && vane_check_millis_.has_value()) {
+            restore_vanes = last_recv_event_millis_ - *vane_check_millis_ < VaneCheckMillis &&
+                            (buffer[7] != (vane_position_[0] | (vane_position_[1] << 4)) ||
+                             buffer[8] != (vane_position_[2] | (vane_position_[3] << 4)));
+            vane_check_millis_.reset();
         }
-
-        // Handle vane 2 position change
-        uint8_t vane2 = (buffer[7] >> 4) & 0x0F;
-        if (vane2 <= 6) {
-            vane_position_[1] = vane2;
-            vane_select_2_.publish_state(*vane_select_2_.at(vane2));
+        if (restore_vanes) {
+            ESP_LOGD(TAG, "unit changed vanes after status change, restoring");
+            scheduler_.request(PendingSendKind::TypeA);
         } else {
-            ESP_LOGE(TAG, "Unexpected vane 2 position: %u", vane2);
-        }
+            // Handle vane 1 position change
+            uint8_t vane1 = buffer[7] & 0x0F;
+            if (vane1 <= 6) {
+                vane_position_[0] = vane1;
+                vane_select_1_.publish_state(*vane_select_1_.at(vane1));
+            } else {
+                ESP_LOGE(TAG, "Unexpected vane 1 position: %u", vane1);
+            }
 
-        // Handle vane 3 position change
-        uint8_t vane3 = buffer[8] & 0x0F;
-        if (vane3 <= 6) {
-            vane_position_[2] = vane3;
-            vane_select_3_.publish_state(*vane_select_3_.at(vane3));
-        } else {
-            ESP_LOGE(TAG, "Unexpected vane 3 position: %u", vane3);
-        }
+            // Handle vane 2 position change
+            uint8_t vane2 = (buffer[7] >> 4) & 0x0F;
+            if (vane2 <= 6) {
+                vane_position_[1] = vane2;
+                vane_select_2_.publish_state(*vane_select_2_.at(vane2));
+            } else {
+                ESP_LOGE(TAG, "Unexpected vane 2 position: %u", vane2);
+            }
 
-        // Handle vane 4 position change
-        uint8_t vane4 = (buffer[8] >> 4) & 0x0F;
-        if (vane4 <= 6) {
-            vane_position_[3] = vane4;
-            vane_select_4_.publish_state(*vane_select_4_.at(vane4));
-        } else {
-            ESP_LOGE(TAG, "Unexpected vane 4 position: %u", vane4);
+            // Handle vane 3 position change
+            uint8_t vane3 = buffer[8] & 0x0F;
+            if (vane3 <= 6) {
+                vane_position_[2] = vane3;
+                vane_select_3_.publish_state(*vane_select_3_.at(vane3));
+            } else {
+                ESP_LOGE(TAG, "Unexpected vane 3 position: %u", vane3);
+            }
+
+            // Handle vane 4 position change
+            uint8_t vane4 = (buffer[8] >> 4) & 0x0F;
+            if (vane4 <= 6) {
+                vane_position_[3] = vane4;
+                vane_select_4_.publish_state(*vane_select_4_.at(vane4));
+            } else {
+                ESP_LOGE(TAG, "Unexpected vane 4 position: %u", vane4);
+            }
         }
 
         auto_dry_.publish_state(buffer[11] & 0x8);
@@ -1282,6 +2927,53 @@ private:
         }
     }
 
+    // Handles the DRED mode from the unit's 0xCB message.
+    void process_dred(uint8_t dred) {
+        if (dred_state_sensor_ != nullptr) {
+            dred_state_sensor_->publish_state(dred);
+        }
+        if (requested_dred_.has_value()) {
+            int32_t elapsed = int32_t(last_recv_event_millis_ - dred_request_millis_);
+            if (elapsed < 0) {
+                // Received before the request.
+                return;
+            }
+            if (dred == *requested_dred_) {
+                ESP_LOGD(TAG, "DRED mode %u acknowledged after %" PRIi32 " ms", dred, elapsed);
+                if (dred_latency_sensor_ != nullptr) {
+                    dred_latency_sensor_->publish_state(elapsed);
+                }
+                requested_dred_.reset();
+            } else if (!check_dred_timeout(last_recv_event_millis_)) {
+                return;
+            }
+        }
+        publish_dred_select(dred);
+    }
+
+    // Gives up on a DRED request the unit didn't acknowledge within DredAckTimeoutMillis. Also
+    // called from update() so this happens even if the unit stops sending CB messages.
+    bool check_dred_timeout(uint32_t now) {
+        if (!requested_dred_.has_value() || now - dred_request_millis_ <= DredAckTimeoutMillis) {
+            return false;
+        }
+        ESP_LOGE(TAG, "DRED mode %u not acknowledged by unit", *requested_dred_);
+        requested_dred_.reset();
+        return true;
+    }
+
+    // Show the unit's mode, which may also be changed by a DRED device.
+    void publish_dred_select(uint8_t dred) {
+        if (dred_select_ != nullptr) {
+            optional<size_t> index = dred_select_->active_index();
+            if (!index.has_value() || *index != dred) {
+                ignore_dred_callback_ = true;
+                dred_select_->publish_state(*dred_select_->at(dred));
+                ignore_dred_callback_ = false;
+            }
+        }
+    }
+
     void process_type_b_settings_message(MessageSender sender, const uint8_t* buffer) {
         // Ignore this message from other controllers.
         if (sender != MessageSender::Unit) {
@@ -1292,12 +2984,21 @@ private:
         bool first_time = last_recv_type_b_settings_[0] == 0;
         memcpy(last_recv_type_b_settings_, buffer, MsgLen);
         if (first_time) {
-            pending_type_b_settings_change_ = true;
+            scheduler_.request(PendingSendKind::TypeB);
         }
 
         last_sent_recv_type_b_millis_ = millis();
 
-        uint8_t overheating = (buffer[2] >> 3) & 0b111;
+        TypeBSettingsMessage msg = decode_type_b_settings_message(buffer);
+
+        process_dred(msg.dred);
+
+        if (msg.group_control != group_control_) {
+            group_control_ = msg.group_control;
+            publish_group_units();
+        }
+
+        uint8_t overheating = msg.overheating;
         if (overheating <= 4) {
             overheating_ = overheating;
             overheating_select_.publish_state(*overheating_select_.at(overheating));
@@ -1305,102 +3006,174 @@ private:
             ESP_LOGE(TAG, "Unexpected overheating value: %u", overheating);
         }
 
-        // Table mapping a byte value to degrees Celsius based on values displayed by PREMTB100.
-        // INT8_MIN indicates an invalid value.
-        static constexpr int8_t PipeTempTable[] = {
-            /* 0x00 */ INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN,
-                       INT8_MIN, INT8_MIN, INT8_MIN, 108, 104, 101, 100, 98, 95,
-            /* 0x10 */ 93, 91, 89, 87, 85, 84, 82, 81, 79, 78, 76, 75, 74, 73, 72, 71,
-            /* 0x20 */ 70, 68, 68, 67, 66, 65, 64, 63, 62, 61, 60, 60, 59, 58, 57, 57,
-            /* 0x30 */ 56, 55, 55, 54, 53, 53, 52, 52, 51, 50, 50, 49, 49, 48, 47, 47,
-            /* 0x40 */ 46, 46, 45, 45, 44, 44, 43, 43, 42, 42, 41, 41, 40, 40, 39, 39,
-            /* 0x50 */ 39, 38, 38, 37, 37, 36, 36, 36, 35, 35, 34, 34, 33, 33, 33, 32,
-            /* 0x60 */ 32, 31, 31, 31, 30, 30, 30, 29, 29, 29, 28, 28, 27, 27, 27, 26,
-            /* 0x70 */ 26, 26, 25, 25, 24, 24, 24, 23, 23, 23, 22, 22, 22, 21, 21, 21,
-            /* 0x80 */ 20, 20, 20, 19, 19, 19, 18, 18, 18, 17, 17, 17, 16, 16, 16, 15,
-            /* 0x90 */ 15, 15, 14, 14, 14, 13, 13, 13, 12, 12, 12, 11, 11, 11, 10, 10,
-            /* 0xa0 */ 10, 9, 9, 9, 8, 8, 8, 7, 7, 6, 6, 6, 5, 5, 5, 4,
-            /* 0xb0 */ 4, 4, 3, 3, 3, 2, 2, 2, 1, 1, 0, 0, 0, 0, 0, -1,
-            /* 0xc0 */ -1, -2, -2, -2, -3, -3, -4, -4, -5, -5, -5, -6, -6, -7, -7, -8,
-            /* 0xd0 */ -8, -9, -9, -9, -10, -10, -11, -11, -12, -12, -13, -14, -14, -15, -15, -16,
-            /* 0xe0 */ -16, -17, -18, -18, -19, -20, -20, -21, -22, -22, -23, -24, -25, -26, -27,
-                       -28,
-            /* 0xf0 */ -29, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN,
-                       INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN
-        };
-        static_assert(sizeof(PipeTempTable) == 256);
-        static_assert(PipeTempTable[UINT8_MAX] == INT8_MIN);
-
-        int8_t pipe_temp_in = PipeTempTable[buffer[3]];
+        uint32_t now = millis();
+        int8_t pipe_temp_in = msg.pipe_temp_in;
         if (pipe_temp_in == INT8_MIN) {
             pipe_temp_in_.set_internal(true);
         } else {
             pipe_temp_in_.set_internal(false);
-            pipe_temp_in_.publish_state(pipe_temp_in);
+            pipe_temp_in_window_.add(pipe_temp_in, now);
         }
 
-        int8_t pipe_temp_out = PipeTempTable[buffer[4]];
+        int8_t pipe_temp_out = msg.pipe_temp_out;
         if (pipe_temp_out == INT8_MIN) {
             pipe_temp_out_.set_internal(true);
         } else {
             pipe_temp_out_.set_internal(false);
-            pipe_temp_out_.publish_state(pipe_temp_out);
+            pipe_temp_out_window_.add(pipe_temp_out, now);
         }
 
-        int8_t pipe_temp_mid = PipeTempTable[buffer[5]];
+        int8_t pipe_temp_mid = msg.pipe_temp_mid;
         if (pipe_temp_mid == INT8_MIN) {
             pipe_temp_mid_.set_internal(true);
         } else {
             pipe_temp_mid_.set_internal(false);
-            pipe_temp_mid_.publish_state(pipe_temp_mid);
+            pipe_temp_mid_window_.add(pipe_temp_mid, now);
+        }
+
+        // The unit doesn't report whether it's cooling or heating in auto mode, so only use
+        // the pipe temperatures for the coil statistics in the other modes.
+        if (pipe_temp_in != INT8_MIN && pipe_temp_out != INT8_MIN) {
+            if (this->mode == climate::CLIMATE_MODE_COOL || this->mode == climate::CLIMATE_MODE_DRY) {
+                coil_analytics_.add_pipe_temps(pipe_temp_in, pipe_temp_out, CoilAnalytics::Mode::Cooling, now);
+            } else if (this->mode == climate::CLIMATE_MODE_HEAT) {
+                coil_analytics_.add_pipe_temps(pipe_temp_in, pipe_temp_out, CoilAnalytics::Mode::Heating, now);
+            }
         }
     }
 
-    void update() {
-        ESP_LOGD(TAG, "update");
+    void process_type_6_message(MessageSender sender, const uint8_t* buffer) {
+        if (sender != MessageSender::Unit) {
+            return;
+        }
+        // CE 00: extended capabilities. The unit sends this with the other settings. The meaning
+        // of these bits isn't known yet, so they're only logged.
+        if (buffer[1] == 0x00) {
+            ESP_LOGD(TAG, "extended capabilities: %s", format_hex_pretty(buffer + 2, 10).c_str());
+        }
+        // CE 10: installer settings.
+        if (buffer[1] == 0x10) {
+            process_installer_settings_message(InstallerMessage::Type6, sender, buffer);
+        }
+    }
 
-        bool had_error = false;
-        while (UARTDevice::available() > 0) {
-            if (!UARTDevice::read_byte(&recv_buf_[recv_buf_len_])) {
-                break;
-            }
-            last_recv_millis_ = millis();
-            recv_buf_len_++;
-            if (recv_buf_len_ == MsgLen) {
-                process_message(recv_buf_, &had_error);
-                recv_buf_len_ = 0;
+    void process_installer_settings_message(InstallerMessage type, MessageSender sender, const uint8_t* buffer) {
+        if (sender != MessageSender::Unit) {
+            return;
+        }
+        // Keep staged changes that weren't sent (or verified) yet.
+        InstallerSettingsMessage& msg = installer_messages_[size_t(type)];
+        bool staged = false;
+        for (size_t b = 1; b < MsgLen - 1; b++) {
+            msg.data[b] = (buffer[b] & ~msg.staged_mask[b]) | (msg.data[b] & msg.staged_mask[b]);
+            staged |= msg.staged_mask[b] != 0;
+        }
+        msg.received = true;
+        // Changes staged before the first message are sent now that the other settings are known.
+        if (staged && !slave_) {
+            scheduler_.request(installer_kind(type));
+        }
+        for (const InstallerSettingEntity& entity : installer_settings_) {
+            if (entity.field->message == type) {
+                entity.number->publish_state(get_installer_setting(*entity.field, msg.data));
             }
         }
+    }
 
-        // If we did not receive the message we sent last time, try to send it again next time.
-        // Ignore this when we're initializing because the unit then immediately responds by
-        // sending a lot of messages and this introduces a delay.
-        if (pending_send_ != PendingSendKind::None && !is_initializing_) {
-            ESP_LOGE(TAG, "did not receive message we just sent");
-            switch (pending_send_) {
-                case PendingSendKind::Status:
-                    pending_status_change_ = true;
-                    break;
-                case PendingSendKind::TypeA:
-                    pending_type_a_settings_change_ = true;
-                    break;
-                case PendingSendKind::TypeB:
-                    pending_type_b_settings_change_ = true;
-                    break;
-                case PendingSendKind::None:
-                    ESP_LOGE(TAG, "unreachable");
-                    break;
-            }
-            pending_send_ = PendingSendKind::None;
+    void process_power_message(MessageSender sender, const uint8_t* buffer) {
+        if (sender != MessageSender::Unit) {
             return;
         }
+        PowerMessage msg = decode_power_message(buffer);
+        energy_meter_.add_sample(msg.watts, millis());
+        // Without a window, only publish changes.
+        if (power_window_.is_windowed() || last_power_watts_ != msg.watts) {
+            power_window_.add(msg.watts, millis());
+        }
+        last_power_watts_ = msg.watts;
+    }
 
-        if (recv_buf_len_ > 0) {
-            if (millis() - last_recv_millis_ > 15 * 1000) {
-                ESP_LOGE(TAG, "discarding incomplete data %s",
-                         format_hex_pretty(recv_buf_, recv_buf_len_).c_str());
-                recv_buf_len_ = 0;
+    void update_energy() {
+        if (energy_sensor_ == nullptr) {
+            return;
+        }
+        uint32_t now = millis();
+        energy_meter_.advance(now);
+        if (now - last_energy_publish_millis_ >= energy_publish_interval_) {
+            energy_sensor_->publish_state(energy_meter_.energy_kwh());
+            last_energy_publish_millis_ = now;
+        }
+        // Limit flash writes: save at most once per interval and only if something changed.
+        uint64_t energy = energy_meter_.energy_watt_millis();
+        if (now - last_energy_save_millis_ >= energy_save_interval_ &&
+            energy != last_saved_energy_watt_millis_) {
+            EnergyStorage storage;
+            storage.energy_watt_millis = energy;
+            energy_pref_.save(&storage);
+            last_saved_energy_watt_millis_ = energy;
+            last_energy_save_millis_ = now;
+        }
+    }
+
+    void update_coil_analytics() {
+        if (!coil_analytics_.enabled()) {
+            return;
+        }
+        uint32_t now = millis();
+        if (now - last_coil_publish_millis_ >= CoilPublishIntervalMillis) {
+            coil_analytics_.publish_averages(now);
+            last_coil_publish_millis_ = now;
+        }
+        CoilStorage storage;
+        storage.cooling = coil_analytics_.get_baseline(CoilAnalytics::Mode::Cooling);
+        storage.heating = coil_analytics_.get_baseline(CoilAnalytics::Mode::Heating);
+        if (now - last_coil_save_millis_ >= CoilSaveIntervalMillis &&
+            memcmp(&storage, &last_saved_coil_storage_, sizeof(CoilStorage)) != 0) {
+            coil_pref_.save(&storage);
+            last_saved_coil_storage_ = storage;
+            last_coil_save_millis_ = now;
+        }
+    }
+
+    void update() {
+        ESP_LOGD(TAG, "update");
+
+        bool had_error = had_error_;
+        had_error_ = false;
+
+        update_energy();
+        update_coil_analytics();
+
+        uint32_t now = millis();
+        pipe_temp_in_window_.loop(now);
+        pipe_temp_mid_window_.loop(now);
+        pipe_temp_out_window_.loop(now);
+        power_window_.loop(now);
+        bus_tap_.loop(now);
+
+        if (passive_) {
+            return;
+        }
+
+        // Show the unit's last known DRED mode again if a request timed out.
+        if (check_dred_timeout(now) && last_recv_type_b_settings_[0] != 0) {
+            publish_dred_select(decode_type_b_settings_message(last_recv_type_b_settings_).dred);
+        }
+
+        // If we did not receive messages we sent, try to send them again next time. Messages the
+        // bus engine didn't send yet are kept. Ignore this when we're initializing because the
+        // unit then immediately responds by sending a lot of messages and this introduces a delay.
+        bool retry = false;
+        InFlightTable<PendingSendKind>::Entry expired;
+        while (in_flight_.take_expired(now, &expired)) {
+            if (!is_initializing_) {
+                ESP_LOGE(TAG, "did not receive message we just sent: %s",
+                         format_hex_pretty(expired.data, MsgLen).c_str());
+                set_pending(expired.kind);
+                retry = true;
             }
+        }
+        if (retry) {
             return;
         }
 
@@ -1421,7 +3194,8 @@ private:
                 sleep_timer_.publish_state(0);
                 ignore_sleep_timer_callback_ = false;
                 this->mode = climate::CLIMATE_MODE_OFF;
-                pending_status_change_ = true;
+                scheduler_.request(PendingSendKind::Status);
+                scheduler_.request_vane_follow_up();
                 publish_state();
             } else if (optional<uint32_t> minutes = get_sleep_timer_minutes()) {
                 if (sleep_timer_.state != *minutes) {
@@ -1432,74 +3206,68 @@ private:
             }
         }
 
+        if (!slave_) {
+            check_room_temp_stale();
+            // With a dwell time, the quantized temperature can change without a sensor update.
+            room_temp_changed();
+        }
+
         if (slave_ && is_initializing_) {
             ESP_LOGD(TAG, "Not sending, waiting for other controller or unit to send first");
             return;
         }
 
-        // Make sure the RX pin is idle for at least 500 ms to avoid collisions on the bus as much
-        // as possible. If there is still a collision, we'll likely both start sending at
-        // approximately the same time and the message will hopefully be corrupt (and ignored)
-        // anyway. Else the pending_send_/send_buf_ mechanism should catch it and we try again.
-        //
-        // Note: using digital_read is *much* better for this than using UARTDevice because that
-        // interface has significant delays. It has to wait for a full byte to arrive and this
-        // takes about 9-10 ms with our slow baud rate. There are also various buffers and
-        // timeouts before incoming bytes reach us.
-        //
-        // 500 ms might be overkill, but the device usually sends the same message twice with a
-        // short delay (about 200 ms?) between them so let's not send there either to avoid
-        // collisions.
-        auto check_can_send = [&]() -> bool {
-            while (true) {
-                if (UARTDevice::available() > 0 || !rx_pin_.digital_read()) {
-                    ESP_LOGD(TAG, "line busy, not sending yet");
-                    return false;
-                }
-                if (millis() - millis_now > 500) {
-                    return true;
-                }
-                delay(5);
-            }
-        };
-
-        if (pending_type_a_settings_change_) {
-            if (check_can_send()) {
-                send_type_a_settings_message();
-            }
+        // Wait until the previous burst has been sent and verified.
+        if (!in_flight_.empty()) {
             return;
         }
-        if (pending_type_b_settings_change_) {
-            if (check_can_send()) {
-                send_type_b_settings_message(/* timed = */ false);
-            }
-            return;
+
+        if (zone_change_millis_.has_value() && zones_known_ &&
+            millis_now - *zone_change_millis_ >= zone_batch_millis_) {
+            scheduler_.request(PendingSendKind::Status);
         }
-        // Send a status message if there is a pending change.
-        // Additionally, queue a Type A message after sending the status message because some
-        // units set the vane position to the default setting after changing swing mode or
-        // operation mode.
-        if (pending_status_change_) {
-            if (check_can_send()) {
-                send_status_message();
-                pending_type_a_settings_change_ = true;
-            }
-            return;
+
+        // Determine which messages are due: pending changes, a room temperature change (rate
+        // limited), the regular status message and the AB message to request pipe temperature
+        // values.
+        SendScheduler::Conditions conditions;
+        conditions.initializing = is_initializing_;
+        conditions.room_temp_push = pending_room_temp_send_ && room_temp_push_limiter_.has_token(millis_now);
+        conditions.pipe_temp_poll =
+            !slave_ && millis_now - last_sent_recv_type_b_millis_ > get_pipe_temp_poll_interval(millis_now);
+        SendScheduler::Burst burst = scheduler_.next_burst(millis_now, conditions, in_flight_);
+
+        if (burst.room_temp_push) {
+            room_temp_push_limiter_.consume(millis_now);
         }
-        // Send an AB message every 10 minutes to request pipe temperature values.
-        if (!slave_ && millis_now - last_sent_recv_type_b_millis_ > 10 * 60 * 1000) {
-            if (check_can_send()) {
-                send_type_b_settings_message(/* timed = */ true);
-            }
-            return;
+        if (burst.status_change && !is_initializing_) {
+            vane_check_pending_ = !burst.vane_follow_up;
+            vane_check_millis_.reset();
         }
-        // Send a status message every 20 seconds.
-        // Slave controllers only send a status message when settings are changed.
-        if (!slave_ && millis_now - last_sent_status_millis_ > 20 * 1000) {
-            if (check_can_send()) {
-                send_status_message();
+
+        // Queue all due messages. The bus engine sends them back to back in the next idle window
+        // and each message is verified separately.
+        for (size_t i = 0; i < burst.size; i++) {
+            switch (burst.kinds[i]) {
+                case PendingSendKind::Status:
+                    send_status_message(burst.status_change);
+                    break;
+                case PendingSendKind::TypeA:
+                    send_type_a_settings_message();
+                    break;
+                case PendingSendKind::TypeB:
+                    send_type_b_settings_message(burst.timed_type_b);
+                    break;
+                case PendingSendKind::Installer5:
+                    send_installer_settings_message(InstallerMessage::Type5);
+                    break;
+                case PendingSendKind::Installer6:
+                    send_installer_settings_message(InstallerMessage::Type6);
+                    break;
+                case PendingSendKind::None:
+                    ESP_LOGE(TAG, "unreachable");
+                    break;
             }
-            return;
         }
     }
 };
@@ -0,0 +1,546 @@
+#pragma once
+
+// Message definitions and decoding for the 13-byte protocol (see protocol.md). This is shared by
+// the ESPHome component and the Linux tools in tools/, so it must not depend on ESPHome.
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome::lg_controller {
+
+static constexpr size_t MsgLen = 13;
+
+inline uint8_t calc_checksum(const uint8_t* buffer) {
+    size_t result = 0;
+    for (size_t i = 0; i < 12; i++) {
+        result += buffer[i];
+    }
+    return (result & 0xff) ^ 0x55;
+}
+
+// Whether a message came from the HVAC unit, a master controller, or a slave controller.
+enum class MessageSender : uint8_t { Unit, Master, Slave, Unknown };
+
+inline MessageSender get_message_sender(const uint8_t* buffer) {
+    switch (buffer[0] & 0xf8) {
+        case 0xC8:
+            return MessageSender::Unit;
+        case 0xA8:
+            return MessageSender::Master;
+        case 0x28:
+            return MessageSender::Slave;
+        default:
+            return MessageSender::Unknown;
+    }
+}
+
+// Message type (0-7) stored in the low bits of the first byte.
+inline uint8_t get_message_type(const uint8_t* buffer) {
+    return buffer[0] & 0b111;
+}
+
+// Table mapping a byte value to degrees Celsius based on values displayed by PREMTB100.
+// INT8_MIN indicates an invalid value.
+static constexpr int8_t PipeTempTable[] = {
+    /* 0x00 */ INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN,
+               INT8_MIN, INT8_MIN, INT8_MIN, 108, 104, 101, 100, 98, 95,
+    /* 0x10 */ 93, 91, 89, 87, 85, 84, 82, 81, 79, 78, 76, 75, 74, 73, 72, 71,
+    /* 0x20 */ 70, 68, 68, 67, 66, 65, 64, 63, 62, 61, 60, 60, 59, 58, 57, 57,
+    /* 0x30 */ 56, 55, 55, 54, 53, 53, 52, 52, 51, 50, 50, 49, 49, 48, 47, 47,
+    /* 0x40 */ 46, 46, 45, 45, 44, 44, 43, 43, 42, 42, 41, 41, 40, 40, 39, 39,
+    /* 0x50 */ 39, 38, 38, 37, 37, 36, 36, 36, 35, 35, 34, 34, 33, 33, 33, 32,
+    /* 0x60 */ 32, 31, 31, 31, 30, 30, 30, 29, 29, 29, 28, 28, 27, 27, 27, 26,
+    /* 0x70 */ 26, 26, 25, 25, 24, 24, 24, 23, 23, 23, 22, 22, 22, 21, 21, 21,
+    /* 0x80 */ 20, 20, 20, 19, 19, 19, 18, 18, 18, 17, 17, 17, 16, 16, 16, 15,
+    /* 0x90 */ 15, 15, 14, 14, 14, 13, 13, 13, 12, 12, 12, 11, 11, 11, 10, 10,
+    /* 0xa0 */ 10, 9, 9, 9, 8, 8, 8, 7, 7, 6, 6, 6, 5, 5, 5, 4,
+    /* 0xb0 */ 4, 4, 3, 3, 3, 2, 2, 2, 1, 1, 0, 0, 0, 0, 0, -1,
+    /* 0xc0 */ -1, -2, -2, -2, -3, -3, -4, -4, -5, -5, -5, -6, -6, -7, -7, -8,
+    /* 0xd0 */ -8, -9, -9, -9, -10, -10, -11, -11, -12, -12, -13, -14, -14, -15, -15, -16,
+    /* 0xe0 */ -16, -17, -18, -18, -19, -20, -20, -21, -22, -22, -23, -24, -25, -26, -27,
+               -28,
+    /* 0xf0 */ -29, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN,
+               INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN, INT8_MIN
+};
+static_assert(sizeof(PipeTempTable) == 256);
+static_assert(PipeTempTable[UINT8_MAX] == INT8_MIN);
+
+// Capabilities from the type 1 (0xC9) message. Order must match CapabilityBits below.
+enum class Capability : uint8_t {
+    // Byte 1
+    ZoneStateSetting,
+    Swirl,
+    HorizontalSwing,
+    VerticalSwing,
+    // Byte 2
+    FanAutoSubFunction,
+    Purifier,
+    Humidifier,
+    ModeAuto,
+    ModeAI,
+    ModeHeating,
+    ModeFan,
+    ModeDehumidify,
+    // Byte 3
+    FanAuto,
+    FanPower,
+    FanHigh,
+    FanMedium,
+    FanLow,
+    FanSlow,
+    FanPowerHeating,
+    // Byte 4
+    VaneControl,
+    EspValueSetting,
+    StaticPressureSetting,
+    CeilingHeightSetting,
+    RobotClean,
+    AutoDry,
+    // Byte 5
+    EnergySaving,
+    OverrideMasterSlaveSetting,
+    AutoChangeTempSetting,
+    NoHalfDegrees,
+    OneVane,
+    TwoVanes,
+    // Byte 6
+    ExtraAirflow,
+    FanLowMedium,
+    FanMediumHigh,
+    MinCooling16,
+    // Byte 7
+    AuxHeaterSetting,
+    OverheatingSetting,
+    // Byte 8
+    PipeTempSetting,
+    CentigradeSetting,
+    Zones5To8,
+    EmergencyHeaterSetting,
+    GroupControlSetting,
+    UnitInfoSetting,
+    ClearFilterTimer,
+    // Byte 9
+    AddressCheckSetting,
+    OvercoolingSetting,
+    EnergyUsageSetting,
+    LeakDetectorSetting,
+    // Byte 10
+    Dred,
+    StaticPressureStepSetting,
+    WifiApSetting,
+    FanCoolingThermalOffSetting,
+    PrimaryHeaterSetting,
+    // Byte 11
+    AutoStartSetting,
+    FanInterlockSetting,
+    HimalayaCool,
+    MonsoonComfort,
+    MosquitoAway,
+    ComfortCooling,
+    DryContactSetting,
+
+    // Derived from other bits. The actual flag is unknown: assume 4 vanes if neither 1 nor 2
+    // vanes are supported and the vane control bit is set.
+    FourVanes,
+
+    Count
+};
+
+struct CapabilityBit {
+    Capability capability;
+    uint8_t byte;
+    uint8_t mask;
+};
+
+static constexpr CapabilityBit CapabilityBits[] = {
+    {Capability::ZoneStateSetting, 1, 0x10},
+    {Capability::Swirl, 1, 0x20},
+    {Capability::HorizontalSwing, 1, 0x40},
+    {Capability::VerticalSwing, 1, 0x80},
+    {Capability::FanAutoSubFunction, 2, 0x01},
+    {Capability::Purifier, 2, 0x02},
+    {Capability::Humidifier, 2, 0x04},
+    {Capability::ModeAuto, 2, 0x08},
+    {Capability::ModeAI, 2, 0x10},
+    {Capability::ModeHeating, 2, 0x20},
+    {Capability::ModeFan, 2, 0x40},
+    {Capability::ModeDehumidify, 2, 0x80},
+    {Capability::FanAuto, 3, 0x01},
+    {Capability::FanPower, 3, 0x02},
+    {Capability::FanHigh, 3, 0x04},
+    {Capability::FanMedium, 3, 0x08},
+    {Capability::FanLow, 3, 0x10},
+    {Capability::FanSlow, 3, 0x20},
+    {Capability::FanPowerHeating, 3, 0x80},
+    {Capability::VaneControl, 4, 0x01},
+    {Capability::EspValueSetting, 4, 0x02},
+    {Capability::StaticPressureSetting, 4, 0x04},
+    {Capability::CeilingHeightSetting, 4, 0x08},
+    {Capability::RobotClean, 4, 0x40},
+    {Capability::AutoDry, 4, 0x80},
+    {Capability::EnergySaving, 5, 0x01},
+    {Capability::OverrideMasterSlaveSetting, 5, 0x02},
+    {Capability::AutoChangeTempSetting, 5, 0x04},
+    {Capability::NoHalfDegrees, 5, 0x20},
+    {Capability::OneVane, 5, 0x40},
+    {Capability::TwoVanes, 5, 0x80},
+    {Capability::ExtraAirflow, 6, 0x01},
+    {Capability::FanLowMedium, 6, 0x08},
+    {Capability::FanMediumHigh, 6, 0x10},
+    {Capability::MinCooling16, 6, 0x20},
+    {Capability::AuxHeaterSetting, 7, 0x04},
+    {Capability::OverheatingSetting, 7, 0x80},
+    {Capability::PipeTempSetting, 8, 0x01},
+    {Capability::CentigradeSetting, 8, 0x02},
+    {Capability::Zones5To8, 8, 0x08},
+    {Capability::EmergencyHeaterSetting, 8, 0x10},
+    {Capability::GroupControlSetting, 8, 0x20},
+    {Capability::UnitInfoSetting, 8, 0x40},
+    {Capability::ClearFilterTimer, 8, 0x80},
+    {Capability::AddressCheckSetting, 9, 0x02},
+    {Capability::OvercoolingSetting, 9, 0x04},
+    {Capability::EnergyUsageSetting, 9, 0x10},
+    {Capability::LeakDetectorSetting, 9, 0x80},
+    {Capability::Dred, 10, 0x01},
+    {Capability::StaticPressureStepSetting, 10, 0x02},
+    {Capability::WifiApSetting, 10, 0x04},
+    {Capability::FanCoolingThermalOffSetting, 10, 0x40},
+    {Capability::PrimaryHeaterSetting, 10, 0x80},
+    {Capability::AutoStartSetting, 11, 0x01},
+    {Capability::FanInterlockSetting, 11, 0x02},
+    {Capability::HimalayaCool, 11, 0x04},
+    {Capability::MonsoonComfort, 11, 0x08},
+    {Capability::MosquitoAway, 11, 0x10},
+    {Capability::ComfortCooling, 11, 0x20},
+    {Capability::DryContactSetting, 11, 0x80},
+};
+
+constexpr bool capability_bits_in_order() {
+    for (size_t i = 0; i < sizeof(CapabilityBits) / sizeof(CapabilityBits[0]); i++) {
+        if (size_t(CapabilityBits[i].capability) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(capability_bits_in_order());
+static_assert(sizeof(CapabilityBits) / sizeof(CapabilityBits[0]) == size_t(Capability::FourVanes));
+
+// Decoded capabilities. Checking a capability is a single bit test.
+class Capabilities {
+    std::bitset<size_t(Capability::Count)> bits_;
+    bool known_ = false;
+    uint8_t unit_kind_ = 0;
+
+public:
+    // Decode a C9 message. An all-zeroes message means the capabilities are unknown.
+    void decode(const uint8_t* buffer) {
+        bits_.reset();
+        known_ = buffer[0] != 0;
+        if (!known_) {
+            return;
+        }
+        for (const CapabilityBit& bit : CapabilityBits) {
+            bits_[size_t(bit.capability)] = (buffer[bit.byte] & bit.mask) != 0;
+        }
+        bits_[size_t(Capability::FourVanes)] = !has(Capability::OneVane) &&
+                                               !has(Capability::TwoVanes) &&
+                                               has(Capability::VaneControl);
+        unit_kind_ = buffer[1] & 0b111;
+    }
+
+    // False if no capabilities message was received yet.
+    bool known() const {
+        return known_;
+    }
+    bool has(Capability capability) const {
+        return bits_[size_t(capability)];
+    }
+    // 1: cassette, 2: duct, 4: wall unit.
+    uint8_t unit_kind() const {
+        return unit_kind_;
+    }
+};
+
+// Zone on/off bits in the status message for zones 1-8. Zones 5-8 are only used by duct units
+// with the Zones5To8 capability, other units use these bits of byte 10 for other things.
+struct ZoneBit {
+    uint8_t byte;
+    uint8_t mask;
+};
+static constexpr size_t MaxZones = 8;
+static constexpr ZoneBit ZoneBits[MaxZones] = {
+    {5, 0x40}, {5, 0x20}, {5, 0x10}, {5, 0x08},
+    {10, 0x10}, {10, 0x08}, {10, 0x04}, {10, 0x02},
+};
+
+// Type 0 (0xA8/0xC8/0x28) status message fields.
+struct StatusMessage {
+    bool changed;
+    bool power;
+    uint8_t mode;          // 0: cool, 1: dehumidify, 2: fan, 3: auto, 4: heat
+    uint8_t fan;           // 0: low, 1: medium, 2: high, 3: auto, 4: slow, ...
+    bool purifier;
+    bool horizontal_swing;
+    bool vertical_swing;
+    bool defrost;
+    bool preheat;
+    bool reservation;
+    bool outdoor;
+    uint8_t thermistor;    // 0: unit, 1: controller, 2: 2TH
+    uint8_t setpoint_x2;   // Setpoint in half degrees
+    uint8_t room_temp_x2;  // Room temperature in half degrees
+    uint8_t timer_kind;
+    uint16_t timer_minutes;
+    uint8_t error;
+};
+
+inline StatusMessage decode_status_message(const uint8_t* buffer) {
+    StatusMessage msg;
+    msg.changed = buffer[1] & 0x1;
+    msg.power = buffer[1] & 0x2;
+    msg.mode = (buffer[1] >> 2) & 0b111;
+    msg.fan = buffer[1] >> 5;
+    msg.purifier = buffer[2] & 0x4;
+    msg.horizontal_swing = buffer[2] & 0x40;
+    msg.vertical_swing = buffer[2] & 0x80;
+    msg.defrost = buffer[3] & 0x4;
+    msg.preheat = buffer[3] & 0x8;
+    msg.reservation = buffer[3] & 0x10;
+    msg.outdoor = buffer[5] & 0x4;
+    msg.thermistor = (buffer[6] >> 4) & 0b11;
+    msg.setpoint_x2 = ((buffer[6] & 0xf) + 15) * 2 + (buffer[5] & 0x1);
+    msg.room_temp_x2 = (buffer[7] & 0x3F) + 20;
+    msg.timer_kind = (buffer[8] >> 3) & 0x7;
+    msg.timer_minutes = (uint16_t(buffer[8] & 0x7) << 8) | buffer[9];
+    msg.error = buffer[11];
+    return msg;
+}
+
+// Descriptions for the error code in byte 11 of status messages. LG controllers display this as
+// CHxx. Based on LG service manuals; some codes differ between indoor unit models.
+struct ErrorCodeDescription {
+    uint8_t code;
+    const char* description;
+};
+
+static constexpr ErrorCodeDescription ErrorCodeDescriptions[] = {
+    {1, "Room temperature sensor"},
+    {2, "Indoor inlet pipe sensor"},
+    {3, "Wired controller communication"},
+    {4, "Drain pump / float switch"},
+    {5, "Indoor/outdoor communication"},
+    {6, "Indoor outlet pipe sensor"},
+    {7, "Operation mode conflict"},
+    {9, "Indoor EEPROM"},
+    {10, "Indoor fan motor"},
+    {21, "Compressor IPM fault"},
+    {22, "Input over current"},
+    {23, "DC link low voltage"},
+    {24, "High pressure switch"},
+    {25, "Input voltage out of range"},
+    {26, "Compressor start failure"},
+    {27, "PFC fault"},
+    {28, "DC link high voltage"},
+    {29, "Compressor over current"},
+    {32, "Discharge pipe high temperature"},
+    {34, "High pressure"},
+    {35, "Low pressure"},
+    {40, "Current sensor"},
+    {41, "Discharge pipe sensor"},
+    {42, "Low pressure sensor"},
+    {43, "High pressure sensor"},
+    {44, "Outdoor air sensor"},
+    {45, "Outdoor condenser pipe sensor"},
+    {46, "Suction pipe sensor"},
+    {48, "Outdoor condenser outlet sensor"},
+    {51, "Capacity mismatch"},
+    {53, "Indoor/outdoor communication (outdoor)"},
+    {54, "Phase reversal"},
+    {60, "Outdoor EEPROM"},
+    {61, "Condenser pipe high temperature"},
+    {62, "Heat sink high temperature"},
+    {65, "Heat sink sensor"},
+    {67, "Outdoor fan lock"},
+};
+
+// Returns nullptr for unknown codes.
+constexpr const char* describe_error_code(uint8_t code) {
+    for (const ErrorCodeDescription& desc : ErrorCodeDescriptions) {
+        if (desc.code == code) {
+            return desc.description;
+        }
+    }
+    return nullptr;
+}
+static_assert(describe_error_code(5) != nullptr);
+static_assert(describe_error_code(0) == nullptr);
+
+// Type 2 (0xAA/0xCA/0x2A) settings message fields.
+struct TypeASettingsMessage {
+    uint8_t address;
+    uint8_t fan_speeds[5]; // Slow, low, medium, high, power
+    uint8_t vanes[4];
+    bool auto_dry;
+};
+
+inline TypeASettingsMessage decode_type_a_settings_message(const uint8_t* buffer) {
+    TypeASettingsMessage msg;
+    msg.address = buffer[1];
+    for (size_t i = 0; i < 5; i++) {
+        msg.fan_speeds[i] = buffer[2 + i];
+    }
+    msg.vanes[0] = buffer[7] & 0x0F;
+    msg.vanes[1] = (buffer[7] >> 4) & 0x0F;
+    msg.vanes[2] = buffer[8] & 0x0F;
+    msg.vanes[3] = (buffer[8] >> 4) & 0x0F;
+    msg.auto_dry = buffer[11] & 0x8;
+    return msg;
+}
+
+// Type 3 (0xAB/0xCB/0x2B) settings message fields.
+struct TypeBSettingsMessage {
+    bool request;
+    uint8_t dred;
+    uint8_t overheating;
+    int8_t pipe_temp_in;   // INT8_MIN if invalid
+    int8_t pipe_temp_out;
+    int8_t pipe_temp_mid;
+    bool group_control;    // Installer setting 19
+};
+
+inline TypeBSettingsMessage decode_type_b_settings_message(const uint8_t* buffer) {
+    TypeBSettingsMessage msg;
+    msg.request = buffer[1] & 0x80;
+    msg.dred = buffer[1] & 0x3;
+    msg.overheating = (buffer[2] >> 3) & 0b111;
+    msg.pipe_temp_in = PipeTempTable[buffer[3]];
+    msg.pipe_temp_out = PipeTempTable[buffer[4]];
+    msg.pipe_temp_mid = PipeTempTable[buffer[5]];
+    msg.group_control = buffer[6] & 0x80;
+    return msg;
+}
+
+// Installer settings stored in type 5 (0xAD/0xCD) and type 6 (0xAE/0xCE with 0x10 in byte 1)
+// messages. Each setting is a bit field in one byte of the message.
+enum class InstallerMessage : uint8_t { Type5, Type6 };
+
+struct InstallerSettingField {
+    uint8_t setting;          // Setting number shown on LG controllers
+    InstallerMessage message;
+    uint8_t byte;
+    uint8_t mask;
+    Capability capability;    // Capability::Count if there's no capability bit for it
+};
+
+static constexpr InstallerSettingField InstallerSettingFields[] = {
+    {25, InstallerMessage::Type5, 1, 0x04, Capability::AuxHeaterSetting},      // Auxiliary heater (1: duct-type)
+    {36, InstallerMessage::Type5, 1, 0x40, Capability::PrimaryHeaterSetting},  // Use primary heater control
+    {38, InstallerMessage::Type5, 1, 0x02, Capability::FanInterlockSetting},   // Fan interlocked with ventilation
+    {39, InstallerMessage::Type5, 1, 0x01, Capability::AutoStartSetting},      // Indoor unit auto start
+    {41, InstallerMessage::Type5, 6, 0x0F, Capability::DryContactSetting},     // Simple dry contact setting
+    {46, InstallerMessage::Type6, 4, 0x02, Capability::Count},                 // Fan continuous
+    {47, InstallerMessage::Type6, 5, 0x10, Capability::Count},                 // Outdoor unit function
+    {48, InstallerMessage::Type6, 3, 0x0F, Capability::Count},                 // Silent mode
+    {49, InstallerMessage::Type6, 3, 0xF0, Capability::Count},                 // Defrost mode
+    {51, InstallerMessage::Type6, 4, 0x04, Capability::Count},                 // Temperature-based fan speed auto
+    {52, InstallerMessage::Type6, 4, 0xF0, Capability::Count},                 // CN_EXT setting
+    // Outdoor unit cycle priority. Raw value: 0x10 for standby, 0x01 | (step << 1) for cool.
+    {56, InstallerMessage::Type6, 6, 0x1F, Capability::Count},
+    {57, InstallerMessage::Type6, 6, 0x40, Capability::Count},                 // Outdoor temp for heating stages
+    {60, InstallerMessage::Type6, 6, 0x20, Capability::Count},                 // Outdoor unit cycle priority (special)
+};
+
+// Returns nullptr for unsupported settings.
+constexpr const InstallerSettingField* find_installer_setting(uint8_t setting) {
+    for (const InstallerSettingField& field : InstallerSettingFields) {
+        if (field.setting == setting) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+constexpr uint8_t installer_setting_shift(const InstallerSettingField& field) {
+    uint8_t shift = 0;
+    while (((field.mask >> shift) & 1) == 0) {
+        shift++;
+    }
+    return shift;
+}
+
+constexpr uint8_t installer_setting_max(const InstallerSettingField& field) {
+    return field.mask >> installer_setting_shift(field);
+}
+
+inline uint8_t get_installer_setting(const InstallerSettingField& field, const uint8_t* buffer) {
+    return (buffer[field.byte] & field.mask) >> installer_setting_shift(field);
+}
+
+inline void set_installer_setting(const InstallerSettingField& field, uint8_t* buffer, uint8_t value) {
+    buffer[field.byte] = (buffer[field.byte] & ~field.mask) |
+                         ((value << installer_setting_shift(field)) & field.mask);
+}
+
+static_assert(installer_setting_max(*find_installer_setting(49)) == 15);
+static_assert(find_installer_setting(1) == nullptr);
+
+// Type 7 (0xAF/0xCF) message fields.
+struct PowerMessage {
+    uint32_t watts;
+};
+
+// Bytes 2-4 store the power usage in watts as six decimal digits, one per nibble. PREMTB100 also
+// displays nibbles above 9 this way (AB.CD.EF => 1123.5 kW), so don't reject those.
+inline PowerMessage decode_power_message(const uint8_t* buffer) {
+    PowerMessage msg;
+    msg.watts = 0;
+    for (size_t i = 2; i <= 4; i++) {
+        msg.watts = msg.watts * 100 + (buffer[i] >> 4) * 10 + (buffer[i] & 0xf);
+    }
+    return msg;
+}
+
+// Bus capture files. All values are little-endian.
+//
+// A capture starts with a CaptureHeader followed by CaptureRecords. Record timestamps are
+// relative to the start time in the header.
+struct CaptureHeader {
+    char magic[4];             // "LGCP"
+    uint16_t version;          // CaptureVersion
+    uint16_t record_size;      // sizeof(CaptureRecord)
+    uint64_t start_unix_micros;
+};
+static_assert(sizeof(CaptureHeader) == 16);
+
+enum class CaptureDirection : uint8_t { Received = 0, Sent = 1 };
+
+struct CaptureRecord {
+    uint64_t timestamp_micros;
+    uint8_t direction;         // CaptureDirection
+    uint8_t flags;             // Reserved, 0
+    uint8_t data[MsgLen];
+    uint8_t padding;
+};
+static_assert(sizeof(CaptureRecord) == 24);
+
+static constexpr uint16_t CaptureVersion = 1;
+
+// Bus tap datagrams (UDP). A datagram is a TapHeader followed by `count` CaptureRecords. Record
+// timestamps are microseconds since the device booted, with the millisecond resolution of the bus
+// engine's event timestamps.
+struct TapHeader {
+    char magic[4];             // "LGTP"
+    uint16_t version;          // TapVersion
+    uint16_t record_size;      // sizeof(CaptureRecord)
+    uint32_t sequence;         // Incremented for each datagram, to detect lost datagrams
+    uint16_t count;
+    uint16_t dropped;          // Records dropped because sending a previous datagram failed
+};
+static_assert(sizeof(TapHeader) == 16);
+
+static constexpr uint16_t TapVersion = 1;
+static constexpr size_t MaxTapRecords = 32;
+
+} // namespace esphome::lg_controller
@@ -0,0 +1,67 @@
+#pragma once
+
+// Lock-free queue between exactly one producer thread and one consumer thread. This doesn't depend
+// on ESPHome or FreeRTOS so it can also be used (and stress tested) with std::thread on Linux.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome::lg_controller {
+
+template <typename T, size_t Size>
+class SpscQueue {
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+
+    T items_[Size] = {};
+
+    // Free-running counters. `head_` is only written by the consumer and `tail_` only by the
+    // producer. Unsigned wraparound keeps `tail_ - head_` correct.
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+
+public:
+    // Producer side. Returns false if the queue is full.
+    bool push(const T& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Size) {
+            return false;
+        }
+        items_[tail & (Size - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns the oldest item without removing it, or nullptr if the queue is empty.
+    // The item stays valid until pop().
+    T* front() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items_[head & (Size - 1)];
+    }
+
+    // Consumer side. Removes the item returned by front().
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Moves the oldest item to `item`. Returns false if the queue is empty.
+    bool pop(T* item) {
+        T* front_item = front();
+        if (front_item == nullptr) {
+            return false;
+        }
+        *item = *front_item;
+        pop();
+        return true;
+    }
+
+    // Can be called from either side, but the result may be outdated immediately.
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+};
+
+} // namespace esphome::lg_controller
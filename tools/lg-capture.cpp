@@ -0,0 +1,593 @@
+// Tool for working with bus capture files (see CaptureHeader in lg-protocol.h). Messages are
+// decoded with the same code as the ESPHome component.
+//
+// Build:
+//
+//    $ g++ -std=c++17 -O2 -Wall -o lg-capture lg-capture.cpp
+//
+// Usage:
+//
+//    lg-capture import-log LOG OUT          Convert `esphome logs` output (the "received ..." and
+//                                           "sending ..." lines) to a capture file.
+//    lg-capture decode CAPTURE...           Print a CSV timeline with decoded fields for each
+//                                           message.
+//    lg-capture stats CAPTURE...            Print message counts and decode throughput. Useful as
+//                                           a benchmark for large captures.
+//    lg-capture replay CAPTURE TTY [SPEED]  Send the received messages in CAPTURE to TTY (for
+//                                           example a pty connected to a controller) with the
+//                                           original timing, divided by SPEED. Bytes written by
+//                                           the controller are echoed back like on the real bus.
+//    lg-capture listen PORT OUT [COUNT]     Receive bus tap datagrams (see `bus_tap`) on UDP PORT
+//                                           and write them to a capture file. Stops after COUNT
+//                                           datagrams if given.
+//
+// The CSV output of `decode` is stable, so it can be compared against a golden file for
+// regression testing:
+//
+//    $ lg-capture decode site1.lgcap | diff - site1.golden.csv
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../esphome/components/lg_controller/lg-protocol.h"
+
+using namespace esphome::lg_controller;
+
+namespace {
+
+double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Memory-mapped capture file.
+class CaptureFile {
+    void* data_ = MAP_FAILED;
+    size_t size_ = 0;
+
+public:
+    const CaptureHeader* header = nullptr;
+    const CaptureRecord* records = nullptr;
+    size_t num_records = 0;
+
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        size_ = st.st_size;
+        if (size_ < sizeof(CaptureHeader)) {
+            fprintf(stderr, "%s: file too small\n", path);
+            close(fd);
+            return false;
+        }
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            fprintf(stderr, "%s: mmap failed: %s\n", path, strerror(errno));
+            return false;
+        }
+        madvise(data_, size_, MADV_SEQUENTIAL);
+
+        header = static_cast<const CaptureHeader*>(data_);
+        if (memcmp(header->magic, "LGCP", 4) != 0 || header->version != CaptureVersion ||
+            header->record_size != sizeof(CaptureRecord)) {
+            fprintf(stderr, "%s: not a supported capture file\n", path);
+            return false;
+        }
+        records = reinterpret_cast<const CaptureRecord*>(static_cast<const uint8_t*>(data_) + sizeof(CaptureHeader));
+        num_records = (size_ - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+        return true;
+    }
+
+    ~CaptureFile() {
+        if (data_ != MAP_FAILED) {
+            munmap(data_, size_);
+        }
+    }
+};
+
+// Buffered output without printf overhead.
+class Output {
+    static constexpr size_t BufSize = 1 << 20;
+    char buf_[BufSize];
+    size_t len_ = 0;
+
+public:
+    ~Output() { flush(); }
+
+    void flush() {
+        fwrite(buf_, 1, len_, stdout);
+        len_ = 0;
+    }
+    void reserve(size_t n) {
+        if (len_ + n > BufSize) {
+            flush();
+        }
+    }
+    void str(const char* s) {
+        size_t n = strlen(s);
+        reserve(n);
+        memcpy(buf_ + len_, s, n);
+        len_ += n;
+    }
+    void chr(char c) {
+        reserve(1);
+        buf_[len_++] = c;
+    }
+    void uint(uint64_t v) {
+        char tmp[20];
+        size_t n = 0;
+        do {
+            tmp[n++] = char('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        reserve(n);
+        while (n > 0) {
+            buf_[len_++] = tmp[--n];
+        }
+    }
+    void sint(int64_t v) {
+        if (v < 0) {
+            chr('-');
+            v = -v;
+        }
+        uint(uint64_t(v));
+    }
+    // Value stored in half units, printed with one decimal.
+    void halves(uint32_t v) {
+        uint(v / 2);
+        str((v & 1) ? ".5" : ".0");
+    }
+    void hex(const uint8_t* data, size_t len) {
+        static const char digits[] = "0123456789abcdef";
+        reserve(len * 2);
+        for (size_t i = 0; i < len; i++) {
+            buf_[len_++] = digits[data[i] >> 4];
+            buf_[len_++] = digits[data[i] & 0xf];
+        }
+    }
+};
+
+const char* sender_name(MessageSender sender) {
+    switch (sender) {
+        case MessageSender::Unit:
+            return "unit";
+        case MessageSender::Master:
+            return "master";
+        case MessageSender::Slave:
+            return "slave";
+        default:
+            return "unknown";
+    }
+}
+
+int cmd_decode(int argc, char** argv) {
+    Output out;
+    out.str("time_s,dir,raw,sender,type,checksum_ok,power,mode,fan,setpoint,room_temp,thermistor,"
+            "defrost,preheat,outdoor,error,vane1,vane2,vane3,vane4,pipe_in,pipe_mid,pipe_out,dred,"
+            "overheating\n");
+    for (int i = 0; i < argc; i++) {
+        CaptureFile file;
+        if (!file.open(argv[i])) {
+            return 1;
+        }
+        for (size_t r = 0; r < file.num_records; r++) {
+            const CaptureRecord& rec = file.records[r];
+            const uint8_t* buf = rec.data;
+            out.uint(rec.timestamp_micros / 1000000);
+            out.chr('.');
+            uint32_t frac = uint32_t(rec.timestamp_micros % 1000000);
+            for (uint32_t div = 100000; div > 0; div /= 10) {
+                out.chr(char('0' + frac / div % 10));
+            }
+            out.str(rec.direction == uint8_t(CaptureDirection::Sent) ? ",tx," : ",rx,");
+            out.hex(buf, MsgLen);
+            out.chr(',');
+            out.str(sender_name(get_message_sender(buf)));
+            out.chr(',');
+            uint8_t type = get_message_type(buf);
+            out.uint(type);
+            bool ok = calc_checksum(buf) == buf[12];
+            out.str(ok ? ",1" : ",0");
+            if (!ok) {
+                out.str(",,,,,,,,,,,,,,,,,,,\n");
+                continue;
+            }
+            switch (type) {
+                case 0: {
+                    StatusMessage msg = decode_status_message(buf);
+                    out.chr(',');
+                    out.uint(msg.power);
+                    out.chr(',');
+                    out.uint(msg.mode);
+                    out.chr(',');
+                    out.uint(msg.fan);
+                    out.chr(',');
+                    out.halves(msg.setpoint_x2);
+                    out.chr(',');
+                    out.halves(msg.room_temp_x2);
+                    out.chr(',');
+                    out.uint(msg.thermistor);
+                    out.chr(',');
+                    out.uint(msg.defrost);
+                    out.chr(',');
+                    out.uint(msg.preheat);
+                    out.chr(',');
+                    out.uint(msg.outdoor);
+                    out.chr(',');
+                    out.uint(msg.error);
+                    out.str(",,,,,,,,,\n");
+                    break;
+                }
+                case 2: {
+                    TypeASettingsMessage msg = decode_type_a_settings_message(buf);
+                    out.str(",,,,,,,,,,");
+                    for (uint8_t vane : msg.vanes) {
+                        out.chr(',');
+                        out.uint(vane);
+                    }
+                    out.str(",,,,,\n");
+                    break;
+                }
+                case 3: {
+                    TypeBSettingsMessage msg = decode_type_b_settings_message(buf);
+                    out.str(",,,,,,,,,,,,,,");
+                    for (int8_t temp : {msg.pipe_temp_in, msg.pipe_temp_mid, msg.pipe_temp_out}) {
+                        out.chr(',');
+                        if (temp != INT8_MIN) {
+                            out.sint(temp);
+                        }
+                    }
+                    out.chr(',');
+                    out.uint(msg.dred);
+                    out.chr(',');
+                    out.uint(msg.overheating);
+                    out.chr('\n');
+                    break;
+                }
+                default:
+                    out.str(",,,,,,,,,,,,,,,,,,,\n");
+                    break;
+            }
+        }
+    }
+    return 0;
+}
+
+int cmd_stats(int argc, char** argv) {
+    // Counts per sender (4) and message type (8).
+    uint64_t counts[4][8] = {};
+    uint64_t checksum_errors = 0;
+    uint64_t total = 0;
+    uint64_t bytes = 0;
+    // Accumulate something from the decoded fields so the decoding can't be optimized away.
+    uint64_t decoded = 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < argc; i++) {
+        CaptureFile file;
+        if (!file.open(argv[i])) {
+            return 1;
+        }
+        for (size_t r = 0; r < file.num_records; r++) {
+            const uint8_t* buf = file.records[r].data;
+            if (calc_checksum(buf) != buf[12]) {
+                checksum_errors++;
+                continue;
+            }
+            uint8_t type = get_message_type(buf);
+            counts[uint8_t(get_message_sender(buf))][type]++;
+            if (type == 0) {
+                StatusMessage msg = decode_status_message(buf);
+                decoded += msg.setpoint_x2 + msg.room_temp_x2 + msg.mode;
+            } else if (type == 3) {
+                TypeBSettingsMessage msg = decode_type_b_settings_message(buf);
+                decoded += uint8_t(msg.pipe_temp_in) + uint8_t(msg.pipe_temp_out);
+            }
+        }
+        total += file.num_records;
+        bytes += file.num_records * sizeof(CaptureRecord);
+    }
+    double elapsed = now_seconds() - start;
+
+    static const char* const senders[] = {"unit", "master", "slave", "unknown"};
+    printf("messages:        %llu\n", (unsigned long long)total);
+    printf("checksum errors: %llu\n", (unsigned long long)checksum_errors);
+    for (size_t s = 0; s < 4; s++) {
+        for (size_t t = 0; t < 8; t++) {
+            if (counts[s][t] > 0) {
+                printf("  %-8s type %zu: %llu\n", senders[s], t, (unsigned long long)counts[s][t]);
+            }
+        }
+    }
+    printf("decoded in %.3f s (%.1f MB/s, %.1f M messages/s, checksum %llu)\n", elapsed,
+           bytes / 1e6 / elapsed, total / 1e6 / elapsed, (unsigned long long)(decoded & 0xffff));
+    return 0;
+}
+
+// Parses "[HH:MM:SS]" or "[HH:MM:SS.mmm]" at the start of a log line.
+bool parse_log_time(const char* line, uint64_t* micros) {
+    unsigned h, m, sec, ms = 0;
+    if (sscanf(line, "[%u:%u:%u.%u]", &h, &m, &sec, &ms) < 3) {
+        return false;
+    }
+    *micros = ((uint64_t(h) * 60 + m) * 60 + sec) * 1000000 + uint64_t(ms) * 1000;
+    return true;
+}
+
+int cmd_import_log(const char* log_path, const char* out_path) {
+    FILE* in = fopen(log_path, "r");
+    if (in == nullptr) {
+        fprintf(stderr, "%s: %s\n", log_path, strerror(errno));
+        return 1;
+    }
+    FILE* out = fopen(out_path, "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+        fclose(in);
+        return 1;
+    }
+
+    CaptureHeader header{};
+    memcpy(header.magic, "LGCP", 4);
+    header.version = CaptureVersion;
+    header.record_size = sizeof(CaptureRecord);
+    header.start_unix_micros = 0;
+    fwrite(&header, sizeof(header), 1, out);
+
+    char line[1024];
+    uint64_t first_time = 0, last_time = 0, day_offset = 0;
+    bool have_time = false;
+    size_t count = 0;
+    while (fgets(line, sizeof(line), in)) {
+        CaptureRecord rec{};
+        const char* p;
+        if ((p = strstr(line, ": received ")) != nullptr) {
+            rec.direction = uint8_t(CaptureDirection::Received);
+            p += strlen(": received ");
+        } else if ((p = strstr(line, ": sending ")) != nullptr) {
+            rec.direction = uint8_t(CaptureDirection::Sent);
+            p += strlen(": sending ");
+        } else {
+            continue;
+        }
+        size_t n = 0;
+        while (n < MsgLen) {
+            unsigned v;
+            if (sscanf(p, "%2x", &v) != 1) {
+                break;
+            }
+            rec.data[n++] = uint8_t(v);
+            p += 2;
+            if (*p != '.') {
+                break;
+            }
+            p++;
+        }
+        if (n != MsgLen) {
+            continue;
+        }
+        uint64_t t = 0;
+        if (parse_log_time(line, &t)) {
+            if (!have_time) {
+                first_time = t;
+                have_time = true;
+            } else if (t + day_offset < last_time) {
+                day_offset += uint64_t(24) * 3600 * 1000000;
+            }
+            last_time = t + day_offset;
+            rec.timestamp_micros = last_time - first_time;
+        }
+        fwrite(&rec, sizeof(rec), 1, out);
+        count++;
+    }
+    fclose(in);
+    fclose(out);
+    fprintf(stderr, "imported %zu messages\n", count);
+    return 0;
+}
+
+int cmd_replay(const char* capture_path, const char* tty_path, double speed) {
+    CaptureFile file;
+    if (!file.open(capture_path)) {
+        return 1;
+    }
+    int fd = open(tty_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", tty_path, strerror(errno));
+        return 1;
+    }
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    auto write_all = [fd](const uint8_t* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = write(fd, data, len);
+            if (n < 0) {
+                if (errno == EAGAIN) {
+                    usleep(1000);
+                    continue;
+                }
+                return;
+            }
+            data += n;
+            len -= n;
+        }
+    };
+
+    double start = now_seconds();
+    size_t sent = 0;
+    for (size_t r = 0; r < file.num_records; r++) {
+        const CaptureRecord& rec = file.records[r];
+        if (rec.direction != uint8_t(CaptureDirection::Received)) {
+            continue;
+        }
+        double due = start + rec.timestamp_micros / 1e6 / speed;
+        while (true) {
+            // Echo bytes from the controller while waiting.
+            double wait = due - now_seconds();
+            pollfd pfd{fd, POLLIN, 0};
+            int ret = poll(&pfd, 1, wait > 0 ? int(wait * 1000) + 1 : 0);
+            if (ret > 0 && (pfd.revents & POLLIN)) {
+                uint8_t buf[64];
+                ssize_t n = read(fd, buf, sizeof(buf));
+                if (n > 0) {
+                    write_all(buf, n);
+                }
+            }
+            if (now_seconds() >= due) {
+                break;
+            }
+        }
+        write_all(rec.data, MsgLen);
+        sent++;
+    }
+    close(fd);
+    fprintf(stderr, "replayed %zu messages\n", sent);
+    return 0;
+}
+
+int cmd_listen(int port, const char* out_path, long max_datagrams) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return 1;
+    }
+    FILE* out = fopen(out_path, "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    CaptureHeader header{};
+    memcpy(header.magic, "LGCP", 4);
+    header.version = CaptureVersion;
+    header.record_size = sizeof(CaptureRecord);
+    bool have_start = false;
+    uint64_t first_device_micros = 0;
+    uint32_t next_sequence = 0;
+    size_t records = 0, lost = 0;
+
+    uint8_t buf[sizeof(TapHeader) + MaxTapRecords * sizeof(CaptureRecord)];
+    for (long n = 0; max_datagrams <= 0 || n < max_datagrams;) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len < ssize_t(sizeof(TapHeader))) {
+            continue;
+        }
+        TapHeader tap;
+        memcpy(&tap, buf, sizeof(tap));
+        if (memcmp(tap.magic, "LGTP", 4) != 0 || tap.version != TapVersion ||
+            tap.record_size != sizeof(CaptureRecord) ||
+            size_t(len) != sizeof(TapHeader) + tap.count * sizeof(CaptureRecord)) {
+            fprintf(stderr, "ignoring invalid datagram\n");
+            continue;
+        }
+        n++;
+        if (have_start && tap.sequence != next_sequence) {
+            fprintf(stderr, "lost %u datagram(s)\n", unsigned(tap.sequence - next_sequence));
+        }
+        next_sequence = tap.sequence + 1;
+        lost += tap.dropped;
+
+        for (uint16_t i = 0; i < tap.count; i++) {
+            CaptureRecord rec;
+            memcpy(&rec, buf + sizeof(TapHeader) + i * sizeof(CaptureRecord), sizeof(rec));
+            if (!have_start) {
+                // Use the receive time of the first message as start time.
+                timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                header.start_unix_micros = uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+                fwrite(&header, sizeof(header), 1, out);
+                first_device_micros = rec.timestamp_micros;
+                have_start = true;
+            }
+            rec.timestamp_micros -= first_device_micros;
+            fwrite(&rec, sizeof(rec), 1, out);
+            records++;
+        }
+        fflush(out);
+    }
+    fclose(out);
+    close(fd);
+    fprintf(stderr, "received %zu messages (%zu dropped by device)\n", records, lost);
+    return 0;
+}
+
+int usage(const char* prog) {
+    fprintf(stderr,
+            "Usage:\n"
+            "  %s import-log LOG OUT\n"
+            "  %s decode CAPTURE...\n"
+            "  %s stats CAPTURE...\n"
+            "  %s replay CAPTURE TTY [SPEED]\n"
+            "  %s listen PORT OUT [COUNT]\n",
+            prog, prog, prog, prog, prog);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+    std::string cmd = argv[1];
+    if (cmd == "import-log" && argc == 4) {
+        return cmd_import_log(argv[2], argv[3]);
+    }
+    if (cmd == "decode") {
+        return cmd_decode(argc - 2, argv + 2);
+    }
+    if (cmd == "stats") {
+        return cmd_stats(argc - 2, argv + 2);
+    }
+    if (cmd == "replay" && (argc == 4 || argc == 5)) {
+        double speed = argc == 5 ? atof(argv[4]) : 1;
+        if (speed <= 0) {
+            return usage(argv[0]);
+        }
+        return cmd_replay(argv[2], argv[3], speed);
+    }
+    if (cmd == "listen" && (argc == 4 || argc == 5)) {
+        int port = atoi(argv[2]);
+        if (port <= 0 || port > 65535) {
+            return usage(argv[0]);
+        }
+        return cmd_listen(port, argv[3], argc == 5 ? atol(argv[4]) : 0);
+    }
+    return usage(argv[0]);
+}
@@ -0,0 +1,583 @@
+// Benchmark for the latency from a climate control call to the verified echo of the resulting
+// messages on the bus, in virtual time. This runs the bus engine and in-flight table from the
+// ESPHome component (bus-engine.h) against a simulated 104 bps single-wire bus with other devices
+// on it, so results are reproducible for a given seed.
+//
+// Which messages are sent and when is decided by the same SendScheduler that LgController::update()
+// uses. ControllerModel only builds the messages and does the verification like LgController.
+//
+// Build:
+//
+//    $ g++ -std=c++17 -O2 -Wall -o lg-latency lg-latency.cpp
+//
+// Usage:
+//
+//    lg-latency [--trials N] [--seed N] [--max-p99 MS] [SCENARIO...]
+//
+// Scenarios (all by default):
+//
+// All scenarios change the setpoint, except for scene, preset and dred.
+//
+//    idle       Only the controller is on the bus.
+//    unit       The unit sends its periodic status message (twice) and replies to changes.
+//    slave      Like unit, with an LG slave controller that sends a status message every 20 s.
+//    collision  Another device corrupts the first message sent after the control call.
+//    scene      Like unit, but mode, fan speed and vanes are changed at once.
+//    preset     Like unit, with a preset changing the status, 0xAA and 0xAB messages as one
+//               transaction, and the first message is corrupted so all three are sent again.
+//    dred       Like slave, but a DRED mode is sent as a priority 0xAB message.
+//
+// For each scenario this prints the p50, p99 and max latency in milliseconds, and the number of
+// retries per trial. With --max-p99, the exit status is 1 if any p99 latency exceeds it.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../esphome/components/lg_controller/bus-engine.h"
+
+using namespace esphome::lg_controller;
+
+namespace {
+
+// Time to transmit a single byte (10 bits at 104 bps).
+constexpr uint32_t ByteMillis = 10 * 1000 / 104;
+
+// Give up on a trial after this long.
+constexpr uint32_t TrialTimeoutMillis = 120 * 1000;
+
+// A device on the bus. Bytes in `tx` are transmitted back to back and every byte on the bus
+// (including our own) ends up in `rx`.
+struct Node {
+    std::deque<uint8_t> tx;
+    std::deque<uint8_t> rx;
+    bool transmitting = false;
+};
+
+class Bus {
+    struct Transmission {
+        Node* from;  // nullptr for injected bytes
+        uint8_t value;
+        uint32_t end_millis;
+    };
+    std::vector<Node*> nodes_;
+    std::vector<Transmission> active_;
+    uint32_t idle_since_millis_ = 0;
+
+    void start(Node* from, uint8_t value) {
+        // The line is pulled low by any transmitter, so overlapping bytes are combined with AND
+        // (and likely have framing errors too).
+        for (Transmission& other : active_) {
+            uint8_t other_value = other.value;
+            other.value &= value;
+            value &= other_value;
+        }
+        active_.push_back({from, value, now + ByteMillis});
+        if (from != nullptr) {
+            from->transmitting = true;
+        }
+    }
+
+public:
+    uint32_t now = 0;
+
+    void attach(Node* node) {
+        nodes_.push_back(node);
+    }
+
+    bool active() const {
+        return !active_.empty();
+    }
+
+    uint32_t idle_millis() const {
+        return active() ? 0 : now - idle_since_millis_;
+    }
+
+    // Corrupts the bytes being transmitted, or sends a byte if the line is idle.
+    void inject(uint8_t value) {
+        if (active_.empty()) {
+            start(nullptr, value);
+            return;
+        }
+        for (Transmission& t : active_) {
+            t.value &= value;
+        }
+    }
+
+    void tick() {
+        for (size_t i = 0; i < active_.size();) {
+            Transmission& t = active_[i];
+            if (t.end_millis > now) {
+                i++;
+                continue;
+            }
+            for (Node* node : nodes_) {
+                node->rx.push_back(t.value);
+            }
+            if (t.from != nullptr) {
+                t.from->transmitting = false;
+            }
+            active_.erase(active_.begin() + i);
+            if (active_.empty()) {
+                idle_since_millis_ = now;
+            }
+        }
+        for (Node* node : nodes_) {
+            if (!node->transmitting && !node->tx.empty()) {
+                start(node, node->tx.front());
+                node->tx.pop_front();
+            }
+        }
+        now++;
+    }
+};
+
+using Message = std::vector<uint8_t>;
+
+Message make_message(uint8_t type, uint8_t b1, uint8_t b2) {
+    Message msg(MsgLen, 0);
+    msg[0] = type;
+    msg[1] = b1;
+    msg[2] = b2;
+    msg[MsgLen - 1] = calc_checksum(msg.data());
+    return msg;
+}
+
+// Another device that sends complete messages after the line has been idle for `idle_millis`.
+class Peer : public Node {
+    std::deque<Message> queue_;
+    uint32_t idle_millis_;
+    uint8_t recv_buf_[MsgLen] = {};
+    size_t recv_len_ = 0;
+
+protected:
+    virtual void on_message(const uint8_t* /* buffer */, uint32_t /* now */) {}
+
+public:
+    explicit Peer(uint32_t idle_millis) : idle_millis_(idle_millis) {}
+    virtual ~Peer() = default;
+
+    void send(const Message& msg) {
+        queue_.push_back(msg);
+    }
+
+    virtual void tick(const Bus& bus) {
+        while (!rx.empty()) {
+            recv_buf_[recv_len_++] = rx.front();
+            rx.pop_front();
+            if (recv_len_ == MsgLen) {
+                recv_len_ = 0;
+                if (calc_checksum(recv_buf_) == recv_buf_[MsgLen - 1]) {
+                    on_message(recv_buf_, bus.now);
+                }
+            }
+        }
+        if (tx.empty() && !transmitting && !queue_.empty() && bus.idle_millis() >= idle_millis_) {
+            tx.insert(tx.end(), queue_.front().begin(), queue_.front().end());
+            queue_.pop_front();
+        }
+    }
+};
+
+// Sends a status message (twice) every 60 seconds and replies to changed settings.
+class Unit : public Peer {
+    uint32_t next_status_millis_;
+    uint8_t counter_ = 0;
+
+    void send_status() {
+        Message msg = make_message(0xC8, 0x02, counter_++);
+        send(msg);
+        send(msg);
+    }
+
+protected:
+    void on_message(const uint8_t* buffer, uint32_t /* now */) override {
+        if (get_message_sender(buffer) != MessageSender::Master) {
+            return;
+        }
+        uint8_t type = get_message_type(buffer);
+        if (type == 0 && (buffer[1] & 0x1)) {
+            send_status();
+        } else if (type == 2) {
+            send(make_message(0xCA, buffer[1], buffer[2]));
+        } else if (type == 3) {
+            send(make_message(0xCB, buffer[1], buffer[2]));
+        }
+    }
+
+public:
+    explicit Unit(uint32_t phase_millis) : Peer(100), next_status_millis_(phase_millis) {}
+
+    void tick(const Bus& bus) override {
+        if (bus.now >= next_status_millis_) {
+            send_status();
+            next_status_millis_ += 60 * 1000;
+        }
+        Peer::tick(bus);
+    }
+};
+
+// LG slave controller, sending a status message every 20 seconds.
+class LgSlave : public Peer {
+    uint32_t next_status_millis_;
+    uint8_t counter_ = 0;
+
+public:
+    explicit LgSlave(uint32_t phase_millis) : Peer(500), next_status_millis_(phase_millis) {}
+
+    void tick(const Bus& bus) override {
+        if (bus.now >= next_status_millis_) {
+            send(make_message(0x28, 0x02, counter_++));
+            next_status_millis_ += 20 * 1000;
+        }
+        Peer::tick(bus);
+    }
+};
+
+class NodeBusIo final : public BusIo {
+    Node& node_;
+    const Bus& bus_;
+
+public:
+    NodeBusIo(Node& node, const Bus& bus) : node_(node), bus_(bus) {}
+
+    int available() override {
+        return int(node_.rx.size());
+    }
+    bool read_byte(uint8_t* data) override {
+        if (node_.rx.empty()) {
+            return false;
+        }
+        *data = node_.rx.front();
+        node_.rx.pop_front();
+        return true;
+    }
+    void write_array(const uint8_t* data, size_t len) override {
+        node_.tx.insert(node_.tx.end(), data, data + len);
+    }
+    bool line_active() override {
+        return bus_.active();
+    }
+};
+
+struct Scenario {
+    const char* name;
+    bool unit;
+    bool slave;
+    bool collision;
+    bool mode;
+    bool vanes;
+    bool preset;
+    bool dred;
+};
+
+// Builds and verifies messages like LgController for a master controller that's done
+// initializing. The scheduling is done by SendScheduler.
+class ControllerModel {
+    static constexpr uint32_t UpdateIntervalMillis = 6000;
+    static constexpr size_t NumKinds = size_t(PendingSendKind::Installer6) + 1;
+
+    BusEngine& engine_;
+    SendScheduler::InFlight in_flight_;
+    SendScheduler scheduler_;
+    uint32_t next_update_millis_;
+    uint8_t state_ = 0;
+    bool had_error_ = false;
+
+    // Latency tracking for the current control call.
+    uint32_t control_millis_ = 0;
+    bool outstanding_[NumKinds] = {};
+    uint32_t last_verified_millis_ = 0;
+
+    void send(PendingSendKind kind, bool status_change, uint32_t now, bool priority = false) {
+        Message msg;
+        switch (kind) {
+            case PendingSendKind::Status:
+                msg = make_message(0xA8, status_change ? 0x3 : 0x2, state_);
+                break;
+            case PendingSendKind::TypeA:
+                msg = make_message(0xAA, 0, state_);
+                break;
+            case PendingSendKind::TypeB:
+                msg = make_message(0xAB, 0x80, state_);
+                break;
+            default:
+                return;
+        }
+        if (in_flight_.full()) {
+            return;
+        }
+        bool queued = priority ? engine_.queue_priority_message(msg.data(), now)
+                               : engine_.queue_message(msg.data(), now);
+        if (!queued) {
+            scheduler_.retry(kind);
+            return;
+        }
+        in_flight_.add(msg.data(), kind);
+    }
+
+    // Like LgController::loop(), events are handled as soon as they arrive.
+    void process_events() {
+        BusEvent event;
+        while (engine_.pop_event(&event)) {
+            PendingSendKind kind;
+            switch (event.kind) {
+                case BusEventKind::Received:
+                    if (calc_checksum(event.data) != event.data[MsgLen - 1]) {
+                        had_error_ = true;
+                    } else if (in_flight_.take(event.data, &kind)) {
+                        scheduler_.verified(kind);
+                        if (event.millis >= control_millis_ && outstanding_[size_t(kind)]) {
+                            outstanding_[size_t(kind)] = false;
+                            last_verified_millis_ = event.millis;
+                        }
+                    }
+                    break;
+                case BusEventKind::Sent:
+                    in_flight_.mark_sent(event.data, event.millis, &kind);
+                    break;
+                case BusEventKind::Dropped:
+                    if (in_flight_.take_unsent(event.data, &kind)) {
+                        scheduler_.retry(kind);
+                    }
+                    break;
+                case BusEventKind::Discarded:
+                    break;
+            }
+        }
+    }
+
+    void update(uint32_t now) {
+        bool had_error = had_error_;
+        had_error_ = false;
+
+        bool retry = false;
+        SendScheduler::InFlight::Entry expired;
+        while (in_flight_.take_expired(now, &expired)) {
+            scheduler_.retry(expired.kind);
+            retries++;
+            retry = true;
+        }
+        if (retry || had_error) {
+            return;
+        }
+
+        // The vane check for status changes without a follow-up isn't modeled because the
+        // simulated unit never resets the vanes.
+        SendScheduler::Burst burst = scheduler_.next_burst(now, SendScheduler::Conditions{}, in_flight_);
+        if (burst.vane_follow_up) {
+            outstanding_[size_t(PendingSendKind::TypeA)] |= outstanding_[size_t(PendingSendKind::Status)];
+        }
+        for (size_t i = 0; i < burst.size; i++) {
+            send(burst.kinds[i], burst.status_change, now);
+        }
+    }
+
+public:
+    uint32_t retries = 0;
+
+    ControllerModel(BusEngine& engine, uint32_t update_phase_millis, uint32_t status_phase_millis)
+        : engine_(engine), next_update_millis_(update_phase_millis) {
+        scheduler_.set_last_status_millis(status_phase_millis);
+    }
+
+    // Like LgController::control(), apply_preset() or request_dred().
+    void control(uint32_t now, const Scenario& scenario) {
+        control_millis_ = now;
+        state_++;
+        if (scenario.dred) {
+            outstanding_[size_t(PendingSendKind::TypeB)] = true;
+            if (scheduler_.send_priority(PendingSendKind::TypeB, /* ready = */ true, in_flight_)) {
+                send(PendingSendKind::TypeB, false, now, /* priority = */ true);
+            }
+            return;
+        }
+        scheduler_.request(PendingSendKind::Status);
+        outstanding_[size_t(PendingSendKind::Status)] = true;
+        if (scenario.mode) {
+            scheduler_.request_vane_follow_up();
+        }
+        if (scenario.vanes || scenario.preset) {
+            scheduler_.request(PendingSendKind::TypeA);
+            outstanding_[size_t(PendingSendKind::TypeA)] = true;
+        }
+        if (scenario.preset) {
+            scheduler_.request(PendingSendKind::TypeB);
+            outstanding_[size_t(PendingSendKind::TypeB)] = true;
+            scheduler_.begin_preset(/* initializing = */ false);
+        }
+    }
+
+    bool done() const {
+        return std::none_of(std::begin(outstanding_), std::end(outstanding_), [](bool b) { return b; });
+    }
+
+    uint32_t latency() const {
+        return last_verified_millis_ - control_millis_;
+    }
+
+    void tick(uint32_t now) {
+        process_events();
+        if (now >= next_update_millis_) {
+            update(now);
+            next_update_millis_ += UpdateIntervalMillis;
+        }
+    }
+};
+
+const Scenario Scenarios[] = {
+    {"idle", false, false, false, false, false, false, false},
+    {"unit", true, false, false, false, false, false, false},
+    {"slave", true, true, false, false, false, false, false},
+    {"collision", false, false, true, false, false, false, false},
+    {"scene", true, false, false, true, true, false, false},
+    {"preset", true, false, true, false, false, true, false},
+    {"dred", true, true, false, false, false, false, true},
+};
+
+struct TrialResult {
+    uint32_t latency;
+    uint32_t retries;
+    bool timed_out;
+};
+
+TrialResult run_trial(const Scenario& scenario, std::mt19937& rng) {
+    auto uniform = [&](uint32_t max) { return std::uniform_int_distribution<uint32_t>(0, max - 1)(rng); };
+
+    Bus bus;
+    Node controller_node;
+    bus.attach(&controller_node);
+    NodeBusIo io(controller_node, bus);
+    BusEngine engine;
+    engine.init(&io, 0);
+
+    Unit unit(uniform(60 * 1000));
+    LgSlave slave(uniform(20 * 1000));
+    std::vector<Peer*> peers;
+    if (scenario.unit) {
+        peers.push_back(&unit);
+    }
+    if (scenario.slave) {
+        peers.push_back(&slave);
+    }
+    for (Peer* peer : peers) {
+        bus.attach(peer);
+    }
+
+    ControllerModel controller(engine, uniform(6000), uniform(20 * 1000));
+    uint32_t control_millis = 20 * 1000 + uniform(60 * 1000);
+    bool controlled = false;
+    bool jammed = false;
+    uint32_t jam_millis = 0;
+
+    while (true) {
+        uint32_t now = bus.now;
+        if (!controlled && now >= control_millis) {
+            controller.control(now, scenario);
+            controlled = true;
+        }
+        if (controlled && controller.done()) {
+            return {controller.latency(), controller.retries, false};
+        }
+        if (now >= control_millis + TrialTimeoutMillis) {
+            return {TrialTimeoutMillis, controller.retries, true};
+        }
+        if (scenario.collision && controlled && !jammed) {
+            // Corrupt the second byte of the first message we send after the control call.
+            if (jam_millis == 0 && controller_node.transmitting) {
+                jam_millis = now + ByteMillis + ByteMillis / 2;
+            } else if (jam_millis != 0 && now >= jam_millis) {
+                bus.inject(0x00);
+                jammed = true;
+            }
+        }
+        for (Peer* peer : peers) {
+            peer->tick(bus);
+        }
+        if (now % BusEngine::PollIntervalMillis == 0) {
+            engine.poll(now);
+        }
+        controller.tick(now);
+        bus.tick();
+    }
+}
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+    return sorted[size_t(p * (sorted.size() - 1))];
+}
+
+int usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--trials N] [--seed N] [--max-p99 MS] [SCENARIO...]\n", prog);
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t trials = 500;
+    uint32_t seed = 1;
+    uint32_t max_p99 = 0;
+    std::vector<const Scenario*> selected;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--trials" || arg == "--seed" || arg == "--max-p99") && i + 1 < argc) {
+            uint32_t value = strtoul(argv[++i], nullptr, 10);
+            if (arg == "--trials") {
+                trials = value;
+            } else if (arg == "--seed") {
+                seed = value;
+            } else {
+                max_p99 = value;
+            }
+            continue;
+        }
+        auto it = std::find_if(std::begin(Scenarios), std::end(Scenarios),
+                               [&](const Scenario& s) { return arg == s.name; });
+        if (it == std::end(Scenarios)) {
+            return usage(argv[0]);
+        }
+        selected.push_back(it);
+    }
+    if (trials == 0) {
+        return usage(argv[0]);
+    }
+    if (selected.empty()) {
+        for (const Scenario& scenario : Scenarios) {
+            selected.push_back(&scenario);
+        }
+    }
+
+    printf("%-10s %7s %8s %8s %8s %8s\n", "scenario", "trials", "p50", "p99", "max", "retries");
+    bool failed = false;
+    for (const Scenario* scenario : selected) {
+        // Same seed for each scenario, so adding one doesn't change the others.
+        std::mt19937 rng(seed);
+        std::vector<uint32_t> latencies;
+        uint32_t retries = 0;
+        uint32_t timeouts = 0;
+        for (uint32_t i = 0; i < trials; i++) {
+            TrialResult result = run_trial(*scenario, rng);
+            latencies.push_back(result.latency);
+            retries += result.retries;
+            timeouts += result.timed_out;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        uint32_t p99 = percentile(latencies, 0.99);
+        printf("%-10s %7u %8u %8u %8u %8.2f\n", scenario->name, trials, percentile(latencies, 0.5), p99,
+               latencies.back(), double(retries) / trials);
+        if (timeouts > 0) {
+            printf("  %u trials timed out after %u ms\n", timeouts, TrialTimeoutMillis);
+            failed = true;
+        }
+        if (max_p99 > 0 && p99 > max_p99) {
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}